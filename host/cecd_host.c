@@ -0,0 +1,315 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cecd.h"
+#include "cecd_fake.h"
+#include "cec_message.h"
+#include "connectivity.h"
+#include "seen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs the cecd code against the fake backend on the host, to test and time it off console.
+//   cecd_host <root> add <message file>...  inserts the messages into their inboxes in one batch
+//   cecd_host <root> exchange                runs the SPR part of an exchange with ourselves
+//   cecd_host <root> seen <count> <dup %>   replays a stream of message ids through the seen filter
+//   cecd_host <root> parse <n> <message file>...  times parsing each message n times, view against the old way
+//   cecd_host <root> link                    drives the connectivity monitor with scripted link states
+// Latencies are read from <root>/latency.txt, see cecd_fake.h. The seen filter is kept in <root>/seen.bin
+
+static u32 elapsed_us(u64 start) {
+	return (cecdPlatformTicks() - start) / (CECD_PLATFORM_TICKS_PER_MSEC / 1000);
+}
+
+static u8* read_message(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if (!f) return NULL;
+	u8* buf = malloc(MAX_MESSAGE_SIZE);
+	if (buf && fread(buf, 1, MAX_MESSAGE_SIZE, f) < sizeof(CecMessageHeader)) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+	return buf;
+}
+
+static int run_add(char** paths, int count) {
+	u8** msgbufs = malloc(sizeof(u8*) * count);
+	Result* results = malloc(sizeof(Result) * count);
+	if (!msgbufs || !results) return 1;
+	int num = 0;
+	for (int i = 0; i < count; i++) {
+		u8* buf = read_message(paths[i]);
+		if (!buf) {
+			printf("%s: can't read\n", paths[i]);
+			continue;
+		}
+		msgbufs[num++] = buf;
+	}
+	u64 start = cecdPlatformTicks();
+	Result res = addStreetpassMessages(msgbufs, num, results);
+	u32 us = elapsed_us(start);
+	for (int i = 0; i < num; i++) {
+		CecMessageHeader* msg = (CecMessageHeader*)msgbufs[i];
+		printf("%08lx message %d: %ld\n", (unsigned long)msg->title_id, i, (long)results[i]);
+		free(msgbufs[i]);
+	}
+	printf("addStreetpassMessages(%d): %ld in %lu us\n", num, (long)res, (unsigned long)us);
+	free(results);
+	free(msgbufs);
+	return R_FAILED(res);
+}
+
+static int run_exchange(void) {
+	SlotMetadata slots[12];
+	u32 num_slots = 0;
+	u8* slot = malloc(MAX_SLOT_SIZE);
+	if (!slot) return 1;
+	u64 start = cecdPlatformTicks();
+	Result res = waitForCecdState(false, CEC_COMMAND_OVER_BOSS, CEC_STATE_ABBREV_INACTIVE);
+	printf("enter spr: %ld in %lu us\n", (long)res, (unsigned long)elapsed_us(start));
+	if (R_FAILED(res)) goto cleanup;
+	start = cecdPlatformTicks();
+	res = cecdSprGetSlotsMetadata(sizeof(slots), slots, &num_slots);
+	printf("slots metadata: %ld, %lu slots in %lu us\n", (long)res, (unsigned long)num_slots, (unsigned long)elapsed_us(start));
+	for (int i = 0; R_SUCCEEDED(res) && i < num_slots; i++) {
+		if (!slots[i].size) continue;
+		start = cecdPlatformTicks();
+		Result r = cecdSprGetSlot(slots[i].title_id, slots[i].size, slot);
+		if (R_SUCCEEDED(r)) r = cecdSprAddSlot(slots[i].title_id, slots[i].size, slot);
+		printf("%08lx slot of %lu bytes: %ld in %lu us\n", (unsigned long)slots[i].title_id, (unsigned long)slots[i].size, (long)r, (unsigned long)elapsed_us(start));
+	}
+	start = cecdPlatformTicks();
+	Result exit_res = waitForCecdState(true, CEC_COMMAND_STOP, CEC_STATE_ABBREV_IDLE);
+	printf("exit spr: %ld in %lu us\n", (long)exit_res, (unsigned long)elapsed_us(start));
+	if (R_SUCCEEDED(res)) res = exit_res;
+cleanup:
+	free(slot);
+	return R_FAILED(res);
+}
+
+// a stream of ids in batches of 12, like a receive. Every id is a repeat of an earlier one with
+// dup_percent chance. Each new id is looked up and added, and the filter is written out after every
+// add or after every batch. The two kinds keep the runs apart, so both start out with nothing seen
+static u32 replay_seen(SeenKind kind, int count, int dup_percent, bool flush_each, u32* num_dups, u32* num_writes) {
+	CecMessageId* ids = malloc(sizeof(CecMessageId) * count);
+	if (!ids) return 0;
+	srand(1234);
+	int num_ids = 0;
+	*num_dups = 0;
+	*num_writes = 0;
+	bool dirty = false;
+	u64 start = cecdPlatformTicks();
+	for (int i = 0; i < count; i++) {
+		u8* id = ids[num_ids];
+		if (num_ids && rand() % 100 < dup_percent) {
+			id = ids[rand() % num_ids];
+		} else {
+			for (int j = 0; j < sizeof(CecMessageId); j++) id[j] = rand();
+			num_ids++;
+		}
+		if (seenContains(kind, 0x20800, id)) {
+			(*num_dups)++;
+		} else {
+			seenAdd(kind, 0x20800, id);
+			dirty = true;
+		}
+		if (dirty && (flush_each || i % 12 == 11 || i == count - 1)) {
+			seenFlush();
+			(*num_writes)++;
+			dirty = false;
+		}
+	}
+	u32 us = elapsed_us(start);
+	free(ids);
+	return us;
+}
+
+static int run_seen(int count, int dup_percent) {
+	if (count <= 0 || count > SEEN_RING_SIZE || dup_percent < 0 || dup_percent > 100) {
+		fprintf(stderr, "count must be 1 to %d, dup %% 0 to 100\n", SEEN_RING_SIZE);
+		return 2;
+	}
+	u32 num_dups, num_writes;
+	u32 us = replay_seen(SEEN_INBOX, count, dup_percent, true, &num_dups, &num_writes);
+	printf("flush per message: %d messages, %lu dups, %lu writes in %lu us\n", count, (unsigned long)num_dups, (unsigned long)num_writes, (unsigned long)us);
+	us = replay_seen(SEEN_LOG, count, dup_percent, false, &num_dups, &num_writes);
+	printf("flush per batch:   %d messages, %lu dups, %lu writes in %lu us\n", count, (unsigned long)num_dups, (unsigned long)num_writes, (unsigned long)us);
+	return 0;
+}
+
+// how the messages were taken apart before CecMessageView: the size checks, a walk of the ext
+// headers for every lookup and another one for its size, and memsearch over the body for the mii
+// and the letter box jpegs
+static void* old_ext_header(CecMessageHeader* msg, u32 type, bool want_size) {
+	u32 counter = sizeof(CecMessageHeader);
+	while (counter < msg->total_header_size) {
+		u32 this_type = ((u32*)(((u8*)msg) + counter))[0];
+		u32 this_size = ((u32*)(((u8*)msg) + counter))[1];
+		if (this_type == type) return want_size ? (void*)(size_t)this_size : ((u8*)msg) + counter;
+		counter += this_size;
+		if (counter %4) counter += 4 - counter % 4;
+	}
+	return NULL;
+}
+
+static size_t parse_old(u8* buf, u32* types, int num_types) {
+	CecMessageHeader* msg = (CecMessageHeader*)buf;
+	if (msg->magic != 0x6060) return 0;
+	if (msg->message_size != msg->total_header_size + msg->body_size + 0x20) return 0;
+	if (msg->message_size > MAX_MESSAGE_SIZE) return 0;
+	size_t sink = 0;
+	for (int i = 0; i < num_types; i++) {
+		sink += (size_t)old_ext_header(msg, types[i], false) + (size_t)old_ext_header(msg, types[i], true);
+	}
+	// the old searches ran message_size past the body, here that stops at the end of the buffer
+	u8* body = buf + msg->total_header_size;
+	u32 len = MAX_MESSAGE_SIZE - msg->total_header_size < msg->message_size ? MAX_MESSAGE_SIZE - msg->total_header_size : msg->message_size;
+	sink += (size_t)memsearch(body, len, (u8*)"CFPB", 4);
+	if (msg->title_id == TITLE_LETTER_BOX) {
+		u8 needle[2] = {0xFF, 0xD8};
+		sink += (size_t)memsearch(body, len, needle, 2);
+	}
+	return sink;
+}
+
+static size_t parse_view(u8* buf, u32* types, int num_types) {
+	CecMessageView v;
+	if (!cecMessageViewInit(&v, buf, MAX_MESSAGE_SIZE)) return 0;
+	size_t sink = 0;
+	for (int i = 0; i < num_types; i++) {
+		u32 size;
+		sink += (size_t)cecMessageExtHeader(&v, types[i], &size) + size;
+	}
+	// the mii plaza has its mii at a fixed place, everything else gets searched
+	CecMessageBodyMiiPlaza* body = cecMessageMiiPlaza(&v);
+	sink += body ? (size_t)&body->cfpb : (size_t)cecMessageFindCfpb(&v);
+	u32 size;
+	sink += (size_t)cecMessageLetterBoxJpegs(&v, &size);
+	return sink;
+}
+
+static int run_parse(int iterations, char** paths, int count) {
+	if (iterations <= 0) return 2;
+	for (int i = 0; i < count; i++) {
+		u8* buf = read_message(paths[i]);
+		CecMessageView v;
+		if (!buf || !cecMessageViewInit(&v, buf, MAX_MESSAGE_SIZE)) {
+			printf("%s: not a message\n", paths[i]);
+			if (buf) free(buf);
+			continue;
+		}
+		// every ext header the message has gets looked up once per parse
+		u32 types[CEC_MESSAGE_MAX_EXT_HEADERS];
+		int num_types = v.num_ext_headers;
+		for (int j = 0; j < num_types; j++) types[j] = v.ext_headers[j].type;
+		volatile size_t sink = 0;
+		u64 start = cecdPlatformTicks();
+		for (int j = 0; j < iterations; j++) sink += parse_old(buf, types, num_types);
+		u32 old_us = elapsed_us(start);
+		start = cecdPlatformTicks();
+		for (int j = 0; j < iterations; j++) sink += parse_view(buf, types, num_types);
+		u32 view_us = elapsed_us(start);
+		printf("%s: %08lx, %lu bytes, %d ext headers: old %lu us, view %lu us for %d parses\n", paths[i],
+			(unsigned long)v.header->title_id, (unsigned long)v.header->message_size, num_types,
+			(unsigned long)old_us, (unsigned long)view_us, iterations);
+		free(buf);
+	}
+	return 0;
+}
+
+// the link states the scripted probe hands out, one per poll, '1' for up. The last one sticks
+static const char* link_script;
+static int link_polls;
+
+static bool scripted_probe(void) {
+	int len = strlen(link_script);
+	char c = link_script[link_polls < len ? link_polls : len - 1];
+	link_polls++;
+	return c == '1';
+}
+
+// the events of one poll per script entry: '+' online, '-' offline, '.' nothing
+static bool check_link_events(const char* script, const char* expected) {
+	char events[32];
+	int len = strlen(script);
+	link_script = script;
+	link_polls = 0;
+	connectivityInit();
+	for (int i = 0; i < len && i < sizeof(events) - 1; i++) {
+		ConnectivityEvent e = connectivityPoll();
+		events[i] = e == CONNECTIVITY_EVENT_ONLINE ? '+' : e == CONNECTIVITY_EVENT_OFFLINE ? '-' : '.';
+	}
+	events[len < sizeof(events) - 1 ? len : sizeof(events) - 1] = 0;
+	bool ok = strcmp(events, expected) == 0;
+	printf("%s link %-12s events %-12s expected %s\n", ok ? "ok  " : "FAIL", script, events, expected);
+	return ok;
+}
+
+// a waiter has to wake up on the poll that sees the link come up, or give up after the timeout
+static bool check_link_wait(const char* script, u32 timeout_ms, bool expected, int expected_polls) {
+	link_script = script;
+	link_polls = 0;
+	connectivityInit();
+	bool online = connectivityWaitOnline(timeout_ms);
+	bool ok = online == expected && link_polls == expected_polls;
+	printf("%s wait %-12s %s after %d polls, expected %s after %d\n", ok ? "ok  " : "FAIL", script,
+		online ? "online" : "timeout", link_polls, expected ? "online" : "timeout", expected_polls);
+	return ok;
+}
+
+static int run_link(void) {
+	connectivitySetProbe(scripted_probe);
+	bool ok = true;
+	ok &= check_link_events("1", "+");
+	ok &= check_link_events("0000", "....");
+	// a single down sample while up is roaming flicker, two are a real drop
+	ok &= check_link_events("101010", "+.....");
+	ok &= check_link_events("1000", "+.-.");
+	ok &= check_link_events("0011011001", "..+.....-+");
+	ok &= check_link_wait("0001", 1000, true, 4);
+	ok &= check_link_wait("0", 3 * CONNECTIVITY_POLL_MS, false, 4);
+	connectivitySetProbe(NULL);
+	connectivityExit();
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <root> add <message file>...\n       %s <root> exchange\n       %s <root> seen <count> <dup %%>\n"
+			"       %s <root> parse <n> <message file>...\n       %s <root> link\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+		return 2;
+	}
+	// the link checks don't need a cecd at all
+	if (strcmp(argv[2], "link") == 0) return run_link();
+	char root[100];
+	snprintf(root, sizeof(root), "%s%s", argv[1], argv[1][strlen(argv[1]) - 1] == '/' ? "" : "/");
+	cecdFakeSetRoot(root);
+	char path[120];
+	snprintf(path, sizeof(path), "%sseen.bin", root);
+	seenSetPath(path);
+	seenInit();
+	cecdInit();
+	if (strcmp(argv[2], "add") == 0) return run_add(argv + 3, argc - 3);
+	if (strcmp(argv[2], "exchange") == 0) return run_exchange();
+	if (strcmp(argv[2], "seen") == 0 && argc >= 5) return run_seen(atoi(argv[3]), atoi(argv[4]));
+	if (strcmp(argv[2], "parse") == 0 && argc >= 4) return run_parse(atoi(argv[3]), argv + 4, argc - 4);
+	fprintf(stderr, "unknown command %s\n", argv[2]);
+	return 2;
+}
@@ -0,0 +1,150 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cecd_platform.h"
+#include <time.h>
+#include <errno.h>
+
+#define MAX_EVENTS 16
+
+typedef struct {
+	int refs;
+	bool signaled;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} HostEvent;
+
+static HostEvent events[MAX_EVENTS];
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void cecdPlatformLockInit(CecdPlatformLock* lock) {
+	pthread_mutex_init(lock, NULL);
+}
+
+void cecdPlatformLock(CecdPlatformLock* lock) {
+	pthread_mutex_lock(lock);
+}
+
+void cecdPlatformUnlock(CecdPlatformLock* lock) {
+	pthread_mutex_unlock(lock);
+}
+
+void cecdPlatformCondInit(CecdPlatformCond* cond) {
+	pthread_cond_init(cond, NULL);
+}
+
+void cecdPlatformCondWait(CecdPlatformCond* cond, CecdPlatformLock* lock) {
+	pthread_cond_wait(cond, lock);
+}
+
+void cecdPlatformCondBroadcast(CecdPlatformCond* cond) {
+	pthread_cond_broadcast(cond);
+}
+
+u64 cecdPlatformTicks(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void cecdPlatformSleep(u64 ns) {
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000ULL,
+		.tv_nsec = ns % 1000000000ULL,
+	};
+	while (nanosleep(&ts, &ts) && errno == EINTR);
+}
+
+// handles are the event index plus one, so that 0 stays invalid like on the console
+static HostEvent* get_event(Handle event) {
+	if (!event || event > MAX_EVENTS) return NULL;
+	HostEvent* e = &events[event - 1];
+	return e->refs ? e : NULL;
+}
+
+Result cecdPlatformEventCreate(Handle* event) {
+	pthread_mutex_lock(&events_lock);
+	for (int i = 0; i < MAX_EVENTS; i++) {
+		HostEvent* e = &events[i];
+		if (e->refs) continue;
+		e->refs = 1;
+		e->signaled = false;
+		pthread_mutex_init(&e->lock, NULL);
+		pthread_cond_init(&e->cond, NULL);
+		*event = i + 1;
+		pthread_mutex_unlock(&events_lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&events_lock);
+	*event = 0;
+	return -1;
+}
+
+Result cecdPlatformEventSignal(Handle event) {
+	HostEvent* e = get_event(event);
+	if (!e) return -1;
+	pthread_mutex_lock(&e->lock);
+	e->signaled = true;
+	pthread_cond_signal(&e->cond);
+	pthread_mutex_unlock(&e->lock);
+	return 0;
+}
+
+Result cecdPlatformEventDuplicate(Handle* out, Handle event) {
+	pthread_mutex_lock(&events_lock);
+	HostEvent* e = get_event(event);
+	if (e) e->refs++;
+	pthread_mutex_unlock(&events_lock);
+	*out = e ? event : 0;
+	return e ? 0 : -1;
+}
+
+Result cecdPlatformEventWait(Handle event, s64 timeout_ns) {
+	HostEvent* e = get_event(event);
+	if (!e) return -1;
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_ns / 1000000000LL;
+	deadline.tv_nsec += timeout_ns % 1000000000LL;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	Result res = 0;
+	pthread_mutex_lock(&e->lock);
+	while (!e->signaled) {
+		if (pthread_cond_timedwait(&e->cond, &e->lock, &deadline) == ETIMEDOUT) {
+			res = -1;
+			break;
+		}
+	}
+	// one-shot, like the events cecd hands out
+	e->signaled = false;
+	pthread_mutex_unlock(&e->lock);
+	return res;
+}
+
+void cecdPlatformEventClose(Handle event) {
+	pthread_mutex_lock(&events_lock);
+	HostEvent* e = get_event(event);
+	if (e && !--e->refs) {
+		pthread_mutex_destroy(&e->lock);
+		pthread_cond_destroy(&e->cond);
+	}
+	pthread_mutex_unlock(&events_lock);
+}
@@ -21,50 +21,120 @@
 #include "utils.h"
 #include "config.h"
 #include "report.h"
+#include "exchange_stats.h"
+#include "pending.h"
+#include "connectivity.h"
+#include "cecd_worker.h"
+#include "cec_watcher.h"
+#include "cec_slot.h"
+#include "report_index.h"
 #include <stdlib.h>
 #include <string.h>
 
 int location = -1;
 FS_Archive sharedextdata_b = 0;
 NetpassTitleData title_data;
+// title_data is only ever written on the main thread once the UI runs, so only readers on other
+// threads need title_lock. A reload from the watcher waits in pending_title_data until then
+static LightLock title_lock;
+static NetpassTitleData pending_title_data;
+static CecMboxListHeader pending_mbox_list;
+static bool title_data_pending = false;
+
+void titleDataInit(void) {
+	LightLock_Init(&title_lock);
+}
 
-Result initTitleData(void) {
+static Result load_title_data(NetpassTitleData* data, CecMboxListHeader* mbox_list) {
 	Result res = 0;
-	CecMboxListHeader mbox_list;
-	res = cecdOpenAndRead(0, CEC_PATH_MBOX_LIST, sizeof(CecMboxListHeader), (u8*)&mbox_list);
+	res = cecdOpenAndRead(0, CEC_PATH_MBOX_LIST, sizeof(CecMboxListHeader), (u8*)mbox_list);
 	if (R_FAILED(res)) return res;
+	if (mbox_list->num_boxes > 12) mbox_list->num_boxes = 12;
 	u16 title_name_utf16[65];
-	for (int i = 0; i < mbox_list.num_boxes; i++) {
-		u32 title_id = strtol((const char*)mbox_list.box_names[i], NULL, 16);
+	for (int i = 0; i < mbox_list->num_boxes; i++) {
+		u32 title_id = strtol((const char*)mbox_list->box_names[i], NULL, 16);
 
 		memset(title_name_utf16, 0, sizeof(title_name_utf16));
 		res = cecdOpenAndRead(title_id, CECMESSAGE_BOX_TITLE, sizeof(title_name_utf16)-2, (u8*)title_name_utf16);
 		if (R_FAILED(res)) return res;
 
-		memset(title_data.titles[i].name, 0, sizeof(title_data.titles[i].name));
+		memset(data->titles[i].name, 0, sizeof(data->titles[i].name));
 		// SAFETY: utf16_to_utf8 does not write a null terminator, so we memset above
-		utf16_to_utf8((u8*)title_data.titles[i].name, title_name_utf16, sizeof(title_data.titles[i].name)-1);
+		utf16_to_utf8((u8*)data->titles[i].name, title_name_utf16, sizeof(data->titles[i].name)-1);
 
-		char* ptr = title_data.titles[i].name;
+		char* ptr = data->titles[i].name;
 		while (*ptr) {
 			if (*ptr == '\n') *ptr = ' ';
 			ptr++;
 		}
-		title_data.titles[i].title_id = title_id;
+		data->titles[i].title_id = title_id;
 	}
-	title_data.num_titles = mbox_list.num_boxes;
+	data->num_titles = mbox_list->num_boxes;
 	return res;
 }
 
+Result initTitleData(void) {
+	NetpassTitleData data;
+	CecMboxListHeader mbox_list;
+	Result res = load_title_data(&data, &mbox_list);
+	if (R_FAILED(res)) return res;
+	configPruneIgnoredTitles(&mbox_list);
+	LightLock_Lock(&title_lock);
+	memcpy(&title_data, &data, sizeof(NetpassTitleData));
+	LightLock_Unlock(&title_lock);
+	return res;
+}
+
+Result reloadTitleData(void) {
+	NetpassTitleData data;
+	CecMboxListHeader mbox_list;
+	Result res = load_title_data(&data, &mbox_list);
+	if (R_FAILED(res)) return res;
+	LightLock_Lock(&title_lock);
+	memcpy(&pending_title_data, &data, sizeof(NetpassTitleData));
+	memcpy(&pending_mbox_list, &mbox_list, sizeof(CecMboxListHeader));
+	title_data_pending = true;
+	LightLock_Unlock(&title_lock);
+	return res;
+}
+
+void applyTitleData(void) {
+	CecMboxListHeader mbox_list;
+	LightLock_Lock(&title_lock);
+	bool pending = title_data_pending;
+	if (pending) {
+		memcpy(&title_data, &pending_title_data, sizeof(NetpassTitleData));
+		memcpy(&mbox_list, &pending_mbox_list, sizeof(CecMboxListHeader));
+		title_data_pending = false;
+	}
+	LightLock_Unlock(&title_lock);
+	if (pending) configPruneIgnoredTitles(&mbox_list);
+}
+
 NetpassTitleData* getTitleData(void) {
 	return &title_data;
 }
 
+char* getTitleName(u32 title_id) {
+	char* name = NULL;
+	LightLock_Lock(&title_lock);
+	for (int i = 0; i < title_data.num_titles; i++) {
+		if (title_data.titles[i].title_id == title_id) {
+			name = strdup(title_data.titles[i].name);
+			break;
+		}
+	}
+	LightLock_Unlock(&title_lock);
+	return name;
+}
+
 int numUsedTitles(void) {
 	int num = 0;
+	LightLock_Lock(&title_lock);
 	for (int i = 0; i < title_data.num_titles; i++) {
 		if (!isTitleIgnored(title_data.titles[i].title_id)) num++;
 	}
+	LightLock_Unlock(&title_lock);
 	return num;
 }
 
@@ -154,17 +224,33 @@ Result downloadSlot(int i, SlotInfo* slotinfo) {
 		curlFreeHandler(reply->offset);
 		return res;
 	}
-	CecMessageHeader* msg = (CecMessageHeader*)(reply->ptr + sizeof(CecSlotHeader));
-	CecSlotHeader* slot = (CecSlotHeader*)reply->ptr;
-	metadata->send_method = msg->send_method;
-	metadata->size = slot->size;
-	slotinfo->slots[i] = malloc(slot->size);
+	// nothing from the network goes to cecd unchecked, so we rebuild the slot from the messages that validate
+	CecSlotIter it;
+	if (!cecSlotIterInit(&it, reply->ptr, reply->len)) {
+		printf("Invalid slot for %lx\n", metadata->title_id);
+		metadata->size = 0;
+		curlFreeHandler(reply->offset);
+		return res;
+	}
+	slotinfo->slots[i] = malloc(it.header->size);
 	if (!slotinfo->slots[i]) {
 		res = -1;
 		goto fail;
 	}
-
-	memcpy(slotinfo->slots[i], reply->ptr, slot->size);
+	CecSlotBuilder builder;
+	cecSlotBuilderInit(&builder, slotinfo->slots[i], it.header->size, it.header->title_id, it.header->batch_id);
+	CecMessageView view;
+	while (cecSlotIterNext(&it, &view)) {
+		if (!builder.header->message_count) metadata->send_method = view.header->send_method;
+		cecSlotBuilderAdd(&builder, &view);
+	}
+	if (it.error) printf("Dropped invalid messages for %lx\n", metadata->title_id);
+	metadata->size = builder.header->size;
+	if (!builder.header->message_count) {
+		free(slotinfo->slots[i]);
+		slotinfo->slots[i] = 0;
+		metadata->size = 0;
+	}
 
 	curlFreeHandler(reply->offset);
 	return res;
@@ -174,14 +260,105 @@ fail:
 	return res;
 }
 
+// bad messages and full boxes stay that way, anything else is worth another try
+static bool insert_retryable(Result res) {
+	return R_FAILED(res) && res != -1 && res != -4 && res != -5;
+}
+
+Result downloadTitleInbox(u32 title_id) {
+	Result res = 0;
+	SlotInfo slotinfo;
+	memset(&slotinfo, 0, sizeof(SlotInfo));
+	slotinfo.metadata[0].title_id = title_id;
+	res = downloadSlot(0, &slotinfo);
+	if (R_FAILED(res)) return res;
+	CecSlotHeader* slot = (CecSlotHeader*)slotinfo.slots[0];
+	if (!slot) return res; // nothing new for this title
+
+	// no SPR session here, the messages go straight into the inbox like QR passes do
+	u8** msgbufs = malloc(sizeof(u8*) * slot->message_count);
+	u8** retry_bufs = malloc(sizeof(u8*) * slot->message_count);
+	Result* results = malloc(sizeof(Result) * slot->message_count);
+	Result* retry_results = malloc(sizeof(Result) * slot->message_count);
+	int* retry_idx = malloc(sizeof(int) * slot->message_count);
+	if (!msgbufs || !retry_bufs || !results || !retry_results || !retry_idx) {
+		res = -1;
+		goto cleanup;
+	}
+	int num_msgs = 0;
+	CecSlotIter it;
+	CecMessageView view;
+	cecSlotIterInit(&it, (u8*)slot, slot->size);
+	while (cecSlotIterNext(&it, &view)) {
+		msgbufs[num_msgs++] = view.buf;
+	}
+	// a broken tail was downloaded all the same, fetching again won't bring it back
+	if (it.error) res = DOWNLOAD_INBOX_INSERT_FAILED;
+	if (!num_msgs) goto cleanup;
+	for (int i = 0; i < num_msgs; i++) results[i] = -3; // in case the whole batch bails out early
+	// the server handed the slot out already, so we are the only ones left who have these messages
+	addStreetpassMessages(msgbufs, num_msgs, results);
+	for (int attempt = 1; attempt < DOWNLOAD_INSERT_TRIES; attempt++) {
+		int num_retry = 0;
+		for (int i = 0; i < num_msgs; i++) {
+			if (!insert_retryable(results[i])) continue;
+			retry_idx[num_retry] = i;
+			retry_bufs[num_retry++] = msgbufs[i];
+		}
+		if (!num_retry) break;
+		svcSleepThread((u64)1000000 * DOWNLOAD_INSERT_RETRY_MS);
+		for (int i = 0; i < num_retry; i++) retry_results[i] = -3;
+		addStreetpassMessages(retry_bufs, num_retry, retry_results);
+		for (int i = 0; i < num_retry; i++) results[retry_idx[i]] = retry_results[i];
+	}
+	int added = 0;
+	// everything we got goes into the log, even what didn't make it into the inbox
+	ReportLogBatch* log_batch = reportLogBegin();
+	for (int i = 0; i < num_msgs; i++) {
+		if (log_batch) reportLogAdd(log_batch, (CecMessageHeader*)msgbufs[i]);
+		if (R_SUCCEEDED(results[i])) added++;
+		if (R_FAILED(results[i]) && results[i] != -4) {
+			printf("Failed adding message %d for %08lx: %ld\n", i, title_id, results[i]);
+			res = DOWNLOAD_INBOX_INSERT_FAILED;
+		}
+	}
+	if (log_batch) reportLogCommit(log_batch);
+	printf("Got %d new message(s) for %08lx\n", added, title_id);
+cleanup:
+	if (msgbufs) free(msgbufs);
+	if (retry_bufs) free(retry_bufs);
+	if (results) free(results);
+	if (retry_results) free(retry_results);
+	if (retry_idx) free(retry_idx);
+	free(slot);
+	return res;
+}
+
+static bool title_in_filter(u32 title_id, const u32* title_ids, int num_title_ids) {
+	if (!title_ids) return true;
+	for (int i = 0; i < num_title_ids; i++) {
+		if (title_ids[i] == title_id) return true;
+	}
+	return false;
+}
+
 Result doSlotExchange(void) {
+	return doSlotExchangeTitles(NULL, 0);
+}
+
+Result doSlotExchangeTitles(const u32* title_ids, int num_title_ids) {
 	Result res = 0;
 	TitleExtraInfo title_extra_info[12];
 	memset(&title_extra_info, 0, sizeof(TitleExtraInfo)*12);
 	SlotInfo slotinfo;
 	memset(&slotinfo, 0, sizeof(SlotInfo));
 	char* error_origin = "none";
+	u64 spr_exit_start = 0;
+	// queued changes go out first, e.g. a location entered while offline
+	pendingFlush();
+	exchangeStatsBegin();
 	// first we fetch the mboxlist, extend it and upload it
+	u64 stage_start = exchangeStatsNow();
 	{
 		CecMboxListHeaderWithCapacities mbox_list;
 		res = cecdOpenAndRead(0, CEC_PATH_MBOX_LIST, sizeof(mbox_list.header), (u8*)&mbox_list.header);
@@ -203,8 +380,10 @@ Result doSlotExchange(void) {
 		error_origin = "sending mboxlist ext";
 		if (R_FAILED(res)) goto fail;
 	}
+	exchangeStatsRecord(EXCHANGE_STAGE_MBOX_LIST, stage_start);
 
 	// now we populate the extra data to upload, before we go into cecd state
+	stage_start = exchangeStatsNow();
 	{
 		CecMboxListHeaderWithCapacities mbox_list;
 		res = cecdOpenAndRead(0, CEC_PATH_MBOX_LIST, sizeof(mbox_list.header), (u8*)&mbox_list.header);
@@ -219,6 +398,8 @@ Result doSlotExchange(void) {
 		// now fetch the data
 		for (size_t i = 0; i < mbox_list.header.num_boxes; i++) {
 			u32 title_id = strtol((const char*)mbox_list.header.box_names[i], NULL, 16);
+			// titles without extra info are skipped during the exchange, just like disabled ones
+			if (!title_in_filter(title_id, title_ids, num_title_ids)) continue;
 			title_extra_info[i].title_id = title_id;
 			memset(buf, 0, 200);
 
@@ -242,8 +423,10 @@ Result doSlotExchange(void) {
 		}
 		free(buf);
 	}
+	exchangeStatsRecord(EXCHANGE_STAGE_METADATA, stage_start);
 
 	// get cecd into the spr state
+	stage_start = exchangeStatsNow();
 	error_origin = "Getting cecd into spr state";
 	res = waitForCecdState(false, CEC_COMMAND_OVER_BOSS, CEC_STATE_ABBREV_INACTIVE);
 	if (R_FAILED(res)) goto fail;
@@ -262,6 +445,7 @@ Result doSlotExchange(void) {
 	error_origin = "cecd spr get slots metadata";
 	res = cecdSprGetSlotsMetadata(sizeof(SlotMetadata)*12, slotinfo.metadata, &slots_total);
 	if (R_FAILED(res)) goto fail;
+	exchangeStatsRecord(EXCHANGE_STAGE_SPR_ENTER, stage_start);
 	printf("Uploading outboxes (%ld/%d)", slots_total, numUsedTitles());
 
 	// Upload all slots
@@ -276,7 +460,9 @@ Result doSlotExchange(void) {
 		if (!extra) {
 			continue; // the slot was disabled
 		}
+		stage_start = exchangeStatsNow();
 		Result res2 = uploadSlot(extra, &slotinfo.metadata[i]);
+		exchangeStatsRecord(EXCHANGE_STAGE_UPLOAD, stage_start);
 		if (R_FAILED(res2)) {
 			printf("-");
 		} else {
@@ -290,9 +476,11 @@ Result doSlotExchange(void) {
 		if (R_FAILED(res) || R_FAILED(res = res2)) goto fail;
 	}
 	// we are done sending things
+	stage_start = exchangeStatsNow();
 	res = cecdSprFinaliseSend();
 	error_origin = "finalise send";
 	if (R_FAILED(res)) goto fail;
+	exchangeStatsRecord(EXCHANGE_STAGE_FINALISE_SEND, stage_start);
 	printf(" Done\nDownloading inboxes (%ld/%d)", slots_total, numUsedTitles());
 
 	// time to start download!
@@ -313,12 +501,15 @@ Result doSlotExchange(void) {
 		if (!found) {
 			continue; // the slot was disabled
 		}
+		stage_start = exchangeStatsNow();
 		res = downloadSlot(i, &slotinfo);
 		error_origin = "download slot";
 		if (R_FAILED(res)) goto fail;
+		exchangeStatsRecord(EXCHANGE_STAGE_DOWNLOAD, stage_start);
 	}
 
 	// notify cecd of the slots
+	stage_start = exchangeStatsNow();
 	res = cecdSprAddSlotsMetadata(sizeof(SlotMetadata)*slots_total, (u8*)slotinfo.metadata);
 	error_origin = "add slots metadata";
 	if (R_FAILED(res)) goto fail;
@@ -326,6 +517,9 @@ Result doSlotExchange(void) {
 	// add all slots
 	error_origin = "add slots";
 	int slot_new_data_num = 0;
+	// the slots to log once cecd has them all, the index stays unlocked during the IPC
+	bool log_slot[12];
+	memset(log_slot, 0, sizeof(log_slot));
 	for (int i = 0; i < slots_total; i++) {
 		// make sure the slot isn't disabled
 		bool found = false;
@@ -344,15 +538,30 @@ Result doSlotExchange(void) {
 		}
 		slot_new_data_num++;
 		res = cecdSprAddSlot(slotinfo.metadata[i].title_id, ((CecSlotHeader*)(slotinfo.slots[i]))->size, slotinfo.slots[i]);
-		saveSlotInLog(slotinfo.slots[i]);
+		log_slot[i] = true;
 		if (R_FAILED(res)) {
 			printf("-");
-			goto fail;
+			break;
 		} else {
 			printf("=");
 		}
 	}
+	// the whole receive goes into the log in one batch, so the index is only written once.
+	// What we got so far is kept, even if adding a slot failed
+	u64 log_start = exchangeStatsNow();
+	ReportLogBatch* log_batch = reportLogBegin();
+	for (int i = 0; i < slots_total && log_batch; i++) {
+		if (log_slot[i]) reportLogAddSlot(log_batch, slotinfo.slots[i]);
+	}
+	if (log_batch) reportLogCommit(log_batch);
+	u64 log_write_ticks = exchangeStatsNow() - log_start;
+	exchangeStatsRecord(EXCHANGE_STAGE_LOG_WRITE, log_start);
+	if (R_FAILED(res)) goto fail;
+
+	// the log writes are tracked as their own stage
+	exchangeStatsRecord(EXCHANGE_STAGE_ADD_SLOTS, stage_start + log_write_ticks);
 
+	spr_exit_start = exchangeStatsNow();
 	res = cecdSprFinaliseRecv();
 	error_origin = "cecd spr finalise recv";
 	if (R_FAILED(res)) goto fail;
@@ -364,6 +573,7 @@ Result doSlotExchange(void) {
 
 	goto cleanup;
 fail:
+	if (!spr_exit_start) spr_exit_start = exchangeStatsNow();
 	cecdSprDone(false);
 	_e(res);
 	printf("ERROR (%s): %08lx\n", error_origin, res);
@@ -383,7 +593,10 @@ cleanup:
 		}
 	}
 	// get cecd into the normal state
+	Result exchange_res = res;
 	res = waitForCecdState(true, CEC_COMMAND_STOP, CEC_STATE_ABBREV_IDLE);
+	exchangeStatsRecord(EXCHANGE_STAGE_SPR_EXIT, spr_exit_start);
+	exchangeStatsEnd(R_FAILED(exchange_res) ? exchange_res : res);
 	return res;
 }
 
@@ -408,16 +621,18 @@ cleanup:
 Result setLocation(int location) {
 	Result res;
 	if (config.last_location == location) return -1;
-	char url[80];
-	snprintf(url, 80, "%s/location/%d/enter", BASE_URL, location);
-	res = httpRequest("PUT", url, 0, 0, 0, 0, 0);
-	if (R_FAILED(res)) {
-		printf("ERROR: Failed to enter location %d: %ld\n", location, res);
-		return res;
-	}
+	PendingRecord r;
+	pendingInitRecord(&r, PENDING_LOCATION_ENTER, location);
+	r.prev = config.last_location;
+	res = pendingSubmit(&r);
+	if (R_FAILED(res)) return res;
 	config.last_location = location;
 	configWrite();
-	printf("Entered location %d!\n", location);
+	if (res == PENDING_QUEUED) {
+		printf("Offline, entering location %d once we are back\n", location);
+	} else {
+		printf("Entered location %d!\n", location);
+	}
 	return res;
 }
 
@@ -438,14 +653,29 @@ void triggerDownloadInboxes(void) {
 }
 
 void bgLoop(void* p) {
+	connectivityPoll();
 	do {
-		dl_inbox_status = 2;
-		Result res = doSlotExchange();
-		_e(res);
+		// exchanges are bound to fail while offline, so we don't even try
+		if (connectivityIsOnline()) {
+			dl_inbox_status = 2;
+			// on this thread, a watcher exchange running right now just makes us wait
+			Result res = cecdExchangeLocked(lambda(Result, (void* p) {
+				return doSlotExchange();
+			}), NULL);
+			if (R_SUCCEEDED(res)) cecWatcherResync();
+			// folding the log journal back into the index is best done while nobody is waiting for it
+			reportIndexLock();
+			reportIndexCompact(false);
+			reportIndexUnlock();
+			_e(res);
+		}
 		dl_inbox_status = 0;
 		for(int i = 0; i < 10*60*5; i++) {
 			svcSleepThread((u64)1000000 * 100);
 			if (dl_inbox_status == 1 || !dl_loop_running) break;
+			// check the link once a second, and exchange right away once it comes back
+			if (i % 10 == 0 && connectivityPoll() == CONNECTIVITY_EVENT_ONLINE) break;
+			if (pendingFlushRequested() && connectivityIsOnline()) pendingFlush();
 		}
 	} while(dl_loop_running);
 }
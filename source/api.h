@@ -43,12 +43,30 @@ typedef struct {
 	TitleDataEntry titles[12];
 } NetpassTitleData;
 
+// must be called before any other thread touches the title data
+void titleDataInit(void);
 Result initTitleData(void);
+// for the cecd worker once the UI runs: loads the title data, applyTitleData() takes it over
+// on the main thread, as the scenes read it without a lock
+Result reloadTitleData(void);
+void applyTitleData(void);
+// only for the main thread, other threads use getTitleName()
 NetpassTitleData* getTitleData(void);
+// a copy of the name of the game, to be freed, NULL if we don't know it
+char* getTitleName(u32 title_id);
 int numUsedTitles(void);
 void clearIgnoredTitles(CecMboxListHeader* mbox_list);
 
 Result doSlotExchange(void);
+// only upload and download the slots of the given titles, the mbox list still goes out in full
+Result doSlotExchangeTitles(const u32* title_ids, int num_title_ids);
+// fetch and add only this title's inbox slot, leaving everything else as it is.
+// The slot is gone from the server once we have it, so adding its messages is retried here,
+// and what still fails is logged all the same and reported as DOWNLOAD_INBOX_INSERT_FAILED
+#define DOWNLOAD_INSERT_TRIES 3
+#define DOWNLOAD_INSERT_RETRY_MS 500
+#define DOWNLOAD_INBOX_INSERT_FAILED -6
+Result downloadTitleInbox(u32 title_id);
 Result getLocation(void);
 Result setLocation(int location);
 
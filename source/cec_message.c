@@ -0,0 +1,117 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "cec_message.h"
+#include <string.h>
+
+u8* memsearch(u8* buf, size_t buf_len, u8* cmp, size_t cmp_len) {
+	u8* buf_orig = buf;
+	while (buf_len - ((int)(buf - buf_orig)) > 0 && (buf = memchr(buf, *(uint8_t*)cmp, buf_len - ((int)(buf - buf_orig))))) {
+		if (memcmp(buf, cmp, cmp_len) == 0) {
+			return buf;
+		}
+		buf++;
+	}
+	return NULL;
+}
+
+bool cecMessageViewInit(CecMessageView* v, u8* buf, u32 buf_size) {
+	memset(v, 0, sizeof(CecMessageView));
+	if (buf_size < sizeof(CecMessageHeader)) return false;
+	CecMessageHeader* header = (CecMessageHeader*)buf;
+	if (header->magic != 0x6060) return false; // bad magic
+	if (header->total_header_size < sizeof(CecMessageHeader)) return false;
+	// the sizes are all attacker controlled, so make sure the sum can't wrap
+	if (header->total_header_size > MAX_MESSAGE_SIZE || header->body_size > MAX_MESSAGE_SIZE) return false;
+	if (header->message_size != header->total_header_size + header->body_size + 0x20) return false;
+	if (header->message_size > MAX_MESSAGE_SIZE) return false; // prooobably too large
+	if (header->message_size > buf_size) return false;
+
+	// index the ext headers once, so that lookups don't have to walk them again
+	u32 counter = sizeof(CecMessageHeader);
+	while (counter < header->total_header_size) {
+		if (counter + 8 > header->total_header_size) return false;
+		u32 this_type = ((u32*)(buf + counter))[0];
+		u32 this_size = ((u32*)(buf + counter))[1];
+		if (!this_size || this_size > header->total_header_size - counter) return false;
+		if (v->num_ext_headers < CEC_MESSAGE_MAX_EXT_HEADERS) {
+			CecExtHeaderRef* ref = &v->ext_headers[v->num_ext_headers++];
+			ref->type = this_type;
+			ref->offset = counter;
+			ref->size = this_size;
+		}
+		counter += this_size;
+		// we might have to do extra aligning
+		if (counter %4) counter += 4 - counter % 4;
+	}
+
+	v->buf = buf;
+	v->header = header;
+	v->body = buf + header->total_header_size;
+	v->body_size = header->body_size;
+	return true;
+}
+
+void* cecMessageExtHeader(CecMessageView* v, u32 type, u32* size) {
+	for (int i = 0; i < v->num_ext_headers; i++) {
+		if (v->ext_headers[i].type != type) continue;
+		if (size) *size = v->ext_headers[i].size;
+		return v->buf + v->ext_headers[i].offset;
+	}
+	if (size) *size = 0;
+	return NULL;
+}
+
+CFPB* cecMessageFindCfpb(CecMessageView* v) {
+	u8* ptr = memsearch(v->body, v->body_size, (u8*)"CFPB", 4);
+	if (!ptr || ptr + sizeof(CFPB) > v->body + v->body_size) return NULL;
+	return (CFPB*)ptr;
+}
+
+static void* typed_body(CecMessageView* v, u32 title_id, u32 size) {
+	if (v->header->title_id != title_id || v->body_size < size) return NULL;
+	return v->body;
+}
+
+CecMessageBodyMiiPlaza* cecMessageMiiPlaza(CecMessageView* v) {
+	return typed_body(v, TITLE_MII_PLAZA, sizeof(CecMessageBodyMiiPlaza));
+}
+
+CecMessageBodyMarioKart7* cecMessageMarioKart7(CecMessageView* v) {
+	return typed_body(v, TITLE_MARIO_KART_7, sizeof(CecMessageBodyMarioKart7));
+}
+
+CecMessageBodyTomodachiLife* cecMessageTomodachiLife(CecMessageView* v) {
+	return typed_body(v, TITLE_TOMODACHI_LIFE, sizeof(CecMessageBodyTomodachiLife));
+}
+
+u8* cecMessageLetterBoxJpegs(CecMessageView* v, u32* size) {
+	if (v->header->title_id != TITLE_LETTER_BOX) return NULL;
+	u8 needle[2] = {0xFF, 0xD8};
+	u8* ptr = memsearch(v->body, v->body_size, needle, 2);
+	// the jpegs are preceded by a small header, and the first one by its size.
+	// That header is ReportMessagesEntryLetterBox: total size, jpeg size, 0x60 bytes of padding
+	if (!ptr || ptr < v->body + 0x68 + 4) return NULL;
+	u8* lb = ptr - 0x68 - 4;
+	u32 jpeg_size = ((u32*)lb)[1];
+	u8* jpegs = lb + 0x68;
+	if (jpeg_size > v->body + v->body_size - jpegs) return NULL;
+	*size = jpeg_size;
+	return jpegs;
+}
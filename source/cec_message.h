@@ -0,0 +1,57 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "cecd.h"
+
+#define CEC_MESSAGE_MAX_EXT_HEADERS 16
+
+typedef struct {
+	u32 type;
+	u32 offset; // from the start of the message
+	u32 size;
+} CecExtHeaderRef;
+
+// A message buffer that has been validated once, so that everything handed out
+// afterwards is known to be within the message. Nothing is copied, the view
+// points into the buffer it was created from
+typedef struct {
+	u8* buf;
+	CecMessageHeader* header;
+	u8* body;
+	u32 body_size;
+	int num_ext_headers;
+	CecExtHeaderRef ext_headers[CEC_MESSAGE_MAX_EXT_HEADERS];
+} CecMessageView;
+
+u8* memsearch(u8* buf, size_t buf_len, u8* cmp, size_t cmp_len);
+// buf_size is how much of buf is actually readable, the message must fit in there
+bool cecMessageViewInit(CecMessageView* v, u8* buf, u32 buf_size);
+// returns the ext header including its type and size fields, size is optional
+void* cecMessageExtHeader(CecMessageView* v, u32 type, u32* size);
+// the mii of the sender, if the body has one anywhere
+CFPB* cecMessageFindCfpb(CecMessageView* v);
+
+// the typed bodies return NULL if the message is from another title or too small
+CecMessageBodyMiiPlaza* cecMessageMiiPlaza(CecMessageView* v);
+CecMessageBodyMarioKart7* cecMessageMarioKart7(CecMessageView* v);
+CecMessageBodyTomodachiLife* cecMessageTomodachiLife(CecMessageView* v);
+// the letter box jpegs, each prefixed with its u32 size and padded to four bytes
+u8* cecMessageLetterBoxJpegs(CecMessageView* v, u32* size);
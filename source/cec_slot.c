@@ -0,0 +1,106 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "cec_slot.h"
+#include "utils.h"
+#include <string.h>
+
+static bool valid_header(CecSlotHeader* header, u32 buf_size) {
+	if (header->magic != 0x6161) return false;
+	if (header->size < sizeof(CecSlotHeader) || header->size > buf_size || header->size > MAX_SLOT_SIZE) return false;
+	return true;
+}
+
+bool cecSlotIterInit(CecSlotIter* it, u8* buf, u32 buf_size) {
+	memset(it, 0, sizeof(CecSlotIter));
+	if (buf_size < sizeof(CecSlotHeader)) return false;
+	CecSlotHeader* header = (CecSlotHeader*)buf;
+	if (!valid_header(header, buf_size)) return false;
+	it->header = header;
+	it->ptr = buf + sizeof(CecSlotHeader);
+	it->end = buf + header->size;
+	it->remaining = header->message_count;
+	return true;
+}
+
+bool cecSlotIterNext(CecSlotIter* it, CecMessageView* v) {
+	if (!it->header || !it->remaining || it->error) return false;
+	if (!cecMessageViewInit(v, it->ptr, it->end - it->ptr)) {
+		it->error = true;
+		return false;
+	}
+	it->ptr += v->header->message_size;
+	it->remaining--;
+	return true;
+}
+
+bool cecSlotStreamInit(CecSlotStream* s, FILE* f, u32 file_size) {
+	memset(s, 0, sizeof(CecSlotStream));
+	if (file_size < sizeof(CecSlotHeader)) return false;
+	if (fread_blk(&s->header, sizeof(CecSlotHeader), 1, f) != 1) return false;
+	if (!valid_header(&s->header, file_size)) return false;
+	s->f = f;
+	s->offset = sizeof(CecSlotHeader);
+	s->remaining = s->header.message_count;
+	return true;
+}
+
+bool cecSlotStreamNext(CecSlotStream* s, u8* buf, u32 buf_size, CecMessageView* v) {
+	if (!s->f || !s->remaining || s->error) return false;
+	u32 left = s->header.size - s->offset;
+	CecMessageHeader* header = (CecMessageHeader*)buf;
+	if (left < sizeof(CecMessageHeader) || buf_size < sizeof(CecMessageHeader)
+		|| fread_blk(header, sizeof(CecMessageHeader), 1, s->f) != 1) {
+		s->error = true;
+		return false;
+	}
+	u32 size = header->message_size;
+	if (size < sizeof(CecMessageHeader) || size > left || size > buf_size
+		|| fread_blk(buf + sizeof(CecMessageHeader), size - sizeof(CecMessageHeader), 1, s->f) != 1
+		|| !cecMessageViewInit(v, buf, size)) {
+		s->error = true;
+		return false;
+	}
+	s->offset += size;
+	s->remaining--;
+	return true;
+}
+
+bool cecSlotBuilderInit(CecSlotBuilder* b, u8* buf, u32 capacity, u32 title_id, u32 batch_id) {
+	memset(b, 0, sizeof(CecSlotBuilder));
+	if (capacity < sizeof(CecSlotHeader)) return false;
+	b->header = (CecSlotHeader*)buf;
+	b->capacity = capacity;
+	memset(b->header, 0, sizeof(CecSlotHeader));
+	b->header->magic = 0x6161;
+	b->header->size = sizeof(CecSlotHeader);
+	b->header->title_id = title_id;
+	b->header->batch_id = batch_id;
+	return true;
+}
+
+bool cecSlotBuilderAdd(CecSlotBuilder* b, CecMessageView* v) {
+	if (!b->header) return false;
+	u32 size = v->header->message_size;
+	if (size > b->capacity - b->header->size) return false;
+	memcpy(((u8*)b->header) + b->header->size, v->buf, size);
+	b->header->size += size;
+	b->header->message_count++;
+	return true;
+}
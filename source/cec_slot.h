@@ -0,0 +1,64 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <3ds.h>
+#include <stdio.h>
+#include "cecd.h"
+#include "cec_message.h"
+
+// Walks the messages of a slot that is fully in memory. Every message it hands
+// out has been validated and lies within the slot
+typedef struct {
+	CecSlotHeader* header;
+	u8* ptr;
+	u8* end;
+	u32 remaining; // messages left according to the slot header
+	bool error; // set when we stopped early because of a bad message
+} CecSlotIter;
+
+// buf_size is how much of buf is readable, the slot's own size has to fit in there
+bool cecSlotIterInit(CecSlotIter* it, u8* buf, u32 buf_size);
+bool cecSlotIterNext(CecSlotIter* it, CecMessageView* v);
+
+// Same as above, but reads one message at a time from a file, so that only a
+// single message has to be in memory
+typedef struct {
+	FILE* f;
+	CecSlotHeader header;
+	u32 offset; // bytes of the slot consumed so far
+	u32 remaining;
+	bool error;
+} CecSlotStream;
+
+// f has to be positioned at the slot header, file_size is how many bytes follow
+bool cecSlotStreamInit(CecSlotStream* s, FILE* f, u32 file_size);
+// buf should hold MAX_MESSAGE_SIZE bytes, the returned view points into it
+bool cecSlotStreamNext(CecSlotStream* s, u8* buf, u32 buf_size, CecMessageView* v);
+
+// Assembles a slot in a caller provided buffer
+typedef struct {
+	CecSlotHeader* header;
+	u32 capacity;
+} CecSlotBuilder;
+
+bool cecSlotBuilderInit(CecSlotBuilder* b, u8* buf, u32 capacity, u32 title_id, u32 batch_id);
+// copies the message in, false if it doesn't fit anymore
+bool cecSlotBuilderAdd(CecSlotBuilder* b, CecMessageView* v);
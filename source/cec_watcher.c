@@ -0,0 +1,205 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "cec_watcher.h"
+#include "cecd.h"
+#include "cecd_worker.h"
+#include "api.h"
+#include "config.h"
+#include "connectivity.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WAIT_SLICE_NS (500 * 1000000LL)
+
+typedef struct {
+	u32 title_id;
+	u32 box_size;
+	u32 num_messages;
+	u64 first_message_id;
+} OutboxState;
+
+static Thread watcher_thread = NULL;
+static bool watcher_running = false;
+static volatile bool resync_requested = false;
+// only touched from within the cecd worker
+static OutboxState outbox_states[24];
+static int num_outbox_states = 0;
+static u32 dirty_titles[24];
+static int num_dirty_titles = 0;
+
+static void mark_dirty(u32 title_id) {
+	for (int i = 0; i < num_dirty_titles; i++) {
+		if (dirty_titles[i] == title_id) return;
+	}
+	if (num_dirty_titles < 24) dirty_titles[num_dirty_titles++] = title_id;
+}
+
+static OutboxState* find_state(u32 title_id) {
+	for (int i = 0; i < num_outbox_states; i++) {
+		if (outbox_states[i].title_id == title_id) return &outbox_states[i];
+	}
+	return NULL;
+}
+
+// runs on the cecd worker. With p set, titles whose outbox differs from last time become dirty
+// and we return how many dirty titles there are
+static Result scan_outboxes(void* p) {
+	bool mark = p != NULL;
+	CecMboxListHeader mbox_list;
+	Result res = cecdOpenAndRead(0, CEC_PATH_MBOX_LIST, sizeof(CecMboxListHeader), (u8*)&mbox_list);
+	if (R_FAILED(res)) return res;
+	if (mbox_list.num_boxes > 24) mbox_list.num_boxes = 24;
+	OutboxState states[24];
+	int num_states = 0;
+	bool boxes_changed = false;
+	for (int i = 0; i < mbox_list.num_boxes; i++) {
+		u32 title_id = strtol((const char*)mbox_list.box_names[i], NULL, 16);
+		CecBoxInfoHeader info;
+		if (R_FAILED(cecdOpenAndRead(title_id, CEC_PATH_OUTBOX_INFO, sizeof(CecBoxInfoHeader), (u8*)&info))) continue;
+		CecOBIndex index;
+		memset(&index, 0, sizeof(CecOBIndex));
+		// a replaced message may well have the same size, but it won't have the same id
+		cecdOpenAndRead(title_id, CEC_PATH_OUTBOX_INDEX, sizeof(CecOBIndex), (u8*)&index);
+
+		OutboxState* s = &states[num_states++];
+		s->title_id = title_id;
+		s->box_size = info.box_size;
+		s->num_messages = info.num_messages;
+		s->first_message_id = index.num_messages ? index.message_ids : 0;
+
+		OutboxState* old = find_state(title_id);
+		if (!old) boxes_changed = true;
+		if (!mark || isTitleIgnored(title_id)) continue;
+		if (!old || old->box_size != s->box_size || old->num_messages != s->num_messages || old->first_message_id != s->first_message_id) {
+			DEBUG_PRINTF("Outbox of %08lx changed\n", title_id);
+			mark_dirty(title_id);
+		}
+	}
+	if (num_states != num_outbox_states) boxes_changed = true;
+	memcpy(outbox_states, states, sizeof(OutboxState) * num_states);
+	num_outbox_states = num_states;
+	// a box came or went, so the title data we loaded at startup is stale. The main thread
+	// takes the new one over, the scenes read it as they draw
+	if (mark && boxes_changed) reloadTitleData();
+	return mark ? num_dirty_titles : 0;
+}
+
+static Result resync(void* p) {
+	num_dirty_titles = 0;
+	return scan_outboxes(NULL);
+}
+
+typedef struct {
+	u32 title_ids[24];
+	int num;
+} DirtyTitles;
+
+// runs on the cecd worker
+static Result copy_dirty(void* p) {
+	DirtyTitles* d = (DirtyTitles*)p;
+	d->num = num_dirty_titles;
+	memcpy(d->title_ids, dirty_titles, sizeof(u32) * num_dirty_titles);
+	return 0;
+}
+
+// runs on the cecd worker. Titles that became dirty while we were exchanging stay dirty
+static Result clear_dirty(void* p) {
+	DirtyTitles* d = (DirtyTitles*)p;
+	int num = 0;
+	for (int i = 0; i < num_dirty_titles; i++) {
+		bool sent = false;
+		for (int j = 0; j < d->num; j++) {
+			if (d->title_ids[j] == dirty_titles[i]) sent = true;
+		}
+		if (!sent) dirty_titles[num++] = dirty_titles[i];
+	}
+	num_dirty_titles = num;
+	return 0;
+}
+
+// runs on the watcher thread while holding the exchange lock, so the dirty titles go through the worker
+static Result exchange_dirty(void* p) {
+	DirtyTitles d;
+	cecdWorkerRun(copy_dirty, &d);
+	if (!d.num) return 0;
+	Result res = doSlotExchangeTitles(d.title_ids, d.num);
+	if (R_SUCCEEDED(res)) cecdWorkerRun(clear_dirty, &d);
+	// the exchange itself touches the outboxes, none of that is news to us
+	cecdWorkerRun(scan_outboxes, NULL);
+	return res;
+}
+
+static void watcher(void* p) {
+	Handle event = 0;
+	Result res = cecdGetCecInfoEventHandle(&event);
+	if (R_FAILED(res)) {
+		DEBUG_PRINTF("Failed to get the cec info event: %08lx\n", res);
+		return;
+	}
+	cecdWorkerRun(scan_outboxes, NULL);
+	bool pending = false; // an event we haven't scanned for yet
+	bool dirty = false; // the last scan found outboxes to send
+	u64 last_event = 0;
+	u64 last_exchange = 0;
+	while (watcher_running) {
+		if (R_SUCCEEDED(svcWaitSynchronization(event, WAIT_SLICE_NS))) {
+			pending = true;
+			last_event = svcGetSystemTick();
+		}
+		if (resync_requested) {
+			resync_requested = false;
+			cecdWorkerRun(resync, NULL);
+			dirty = false;
+		}
+		u64 now = svcGetSystemTick();
+		if (pending && now - last_event >= (u64)CEC_WATCHER_DEBOUNCE_MS * CPU_TICKS_PER_MSEC) {
+			pending = false;
+			// any non-NULL argument has the scan mark changed titles dirty
+			Result count = cecdWorkerRun(scan_outboxes, &pending);
+			if (R_SUCCEEDED(count)) dirty = count > 0;
+		}
+		if (!dirty || !connectivityIsOnline()) continue;
+		if (last_exchange && now - last_exchange < (u64)CEC_WATCHER_MIN_INTERVAL_MS * CPU_TICKS_PER_MSEC) continue;
+		last_exchange = now;
+		res = cecdExchangeLocked(exchange_dirty, NULL);
+		// a failed exchange keeps its titles dirty, we retry after the min interval
+		if (R_SUCCEEDED(res)) dirty = false;
+	}
+	svcCloseHandle(event);
+}
+
+void cecWatcherInit(void) {
+	watcher_running = true;
+	watcher_thread = threadCreate(watcher, NULL, 8*1024, main_thread_prio()+1, -2, false);
+	if (!watcher_thread) watcher_running = false;
+}
+
+void cecWatcherExit(void) {
+	if (!watcher_thread) return;
+	watcher_running = false;
+	threadJoin(watcher_thread, U64_MAX);
+	threadFree(watcher_thread);
+	watcher_thread = NULL;
+}
+
+void cecWatcherResync(void) {
+	resync_requested = true;
+}
@@ -0,0 +1,33 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <3ds.h>
+
+// waits on cecd's info event, which fires whenever a box changes, e.g. when a game
+// writes a new outbox message. Titles whose outbox changed get exchanged right away
+#define CEC_WATCHER_DEBOUNCE_MS 3000
+// games tend to write several files in a row, and we don't want to hammer the server either
+#define CEC_WATCHER_MIN_INTERVAL_MS 15000
+
+void cecWatcherInit(void);
+void cecWatcherExit(void);
+// take the current outboxes as the new baseline, e.g. after a full exchange sent them all anyways
+void cecWatcherResync(void);
@@ -16,45 +16,160 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <3ds/types.h>
-#include <3ds/result.h>
-#include <3ds/srv.h>
-#include <3ds/synchronization.h>
+#include "cecd_platform.h"
 #include "cecd.h"
+#include "seen.h"
+#include "debug.h"
+#include "cec_message.h"
+#ifndef CECD_FAKE
 #include <3ds/ipc.h>
+#include "cecd_stats.h"
+#endif
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#ifndef CECD_FAKE
 static Handle cecdHandle;
 static int cecdRefCount;
+#endif
+// SPR sessions need cecd to themselves, box and message access is shared otherwise
+static CecdPlatformLock spr_lock;
+static CecdPlatformCond spr_cond;
 static bool in_spr_mode = false;
+static bool spr_pending = false; // so that a steady stream of box access can't starve SPR
+static int box_users = 0;
+static CecdSprLockStats spr_lock_stats = {0};
 
-void waitForNoSpr(void) {
-	while (in_spr_mode) svcSleepThread((u64)1000000 * 100);
+void cecdSprLockInit(void) {
+	cecdPlatformLockInit(&spr_lock);
+	cecdPlatformCondInit(&spr_cond);
+}
+
+static void record_wait(u32* count, u32* total_ms, u32* max_ms, u64 start) {
+	u32 ms = (cecdPlatformTicks() - start) / CECD_PLATFORM_TICKS_PER_MSEC;
+	(*count)++;
+	*total_ms += ms;
+	if (ms > *max_ms) *max_ms = ms;
+}
+
+void cecdBoxAccessBegin(void) {
+	cecdPlatformLock(&spr_lock);
+	if (in_spr_mode || spr_pending) {
+		u64 start = cecdPlatformTicks();
+		while (in_spr_mode || spr_pending) cecdPlatformCondWait(&spr_cond, &spr_lock);
+		record_wait(&spr_lock_stats.shared_waits, &spr_lock_stats.shared_wait_total_ms, &spr_lock_stats.shared_wait_max_ms, start);
+	}
+	box_users++;
+	cecdPlatformUnlock(&spr_lock);
+}
+
+void cecdBoxAccessEnd(void) {
+	cecdPlatformLock(&spr_lock);
+	box_users--;
+	if (!box_users) cecdPlatformCondBroadcast(&spr_cond);
+	cecdPlatformUnlock(&spr_lock);
+}
+
+void cecdTrackSprMode(CecCommand command) {
+	bool spr = command == CEC_COMMAND_OVER_BOSS || command == CEC_COMMAND_OVER_BOSS_FORCE || command == CEC_COMMAND_OVER_BOSS_FORCE_WAIT;
+	cecdPlatformLock(&spr_lock);
+	if (spr && !in_spr_mode) {
+		spr_pending = true;
+		if (box_users) {
+			u64 start = cecdPlatformTicks();
+			while (box_users) cecdPlatformCondWait(&spr_cond, &spr_lock);
+			record_wait(&spr_lock_stats.exclusive_waits, &spr_lock_stats.exclusive_wait_total_ms, &spr_lock_stats.exclusive_wait_max_ms, start);
+		}
+		spr_pending = false;
+		in_spr_mode = true;
+	} else if (!spr && in_spr_mode) {
+		in_spr_mode = false;
+		// wake up everybody who queued up behind the SPR session right away
+		cecdPlatformCondBroadcast(&spr_cond);
+	}
+	cecdPlatformUnlock(&spr_lock);
+}
+
+void cecdGetSprLockStats(CecdSprLockStats* stats) {
+	cecdPlatformLock(&spr_lock);
+	memcpy(stats, &spr_lock_stats, sizeof(CecdSprLockStats));
+	cecdPlatformUnlock(&spr_lock);
+}
+
+static CecdTransitionStats transition_stats[CECD_MAX_TRANSITION_STATS];
+static int num_transition_stats = 0;
+
+static void record_transition(bool start, int command, CecStateAbbrev state, u32 ms, bool timed_out) {
+	cecdPlatformLock(&spr_lock);
+	CecdTransitionStats* t = NULL;
+	for (int i = 0; i < num_transition_stats; i++) {
+		if (transition_stats[i].start == start && transition_stats[i].command == command && transition_stats[i].state == state) {
+			t = &transition_stats[i];
+			break;
+		}
+	}
+	if (!t && num_transition_stats < CECD_MAX_TRANSITION_STATS) {
+		t = &transition_stats[num_transition_stats++];
+		memset(t, 0, sizeof(CecdTransitionStats));
+		t->start = start;
+		t->command = command;
+		t->state = state;
+	}
+	if (t) {
+		if (timed_out) {
+			t->timeouts++;
+		} else {
+			if (!t->count || ms < t->min_ms) t->min_ms = ms;
+			if (ms > t->max_ms) t->max_ms = ms;
+			t->total_ms += ms;
+			t->count++;
+		}
+	}
+	cecdPlatformUnlock(&spr_lock);
+}
+
+int cecdGetTransitionStats(CecdTransitionStats* stats, int max) {
+	cecdPlatformLock(&spr_lock);
+	int num = num_transition_stats < max ? num_transition_stats : max;
+	memcpy(stats, transition_stats, num * sizeof(CecdTransitionStats));
+	cecdPlatformUnlock(&spr_lock);
+	return num;
 }
 
 Result waitForCecdState(bool start, int command, CecStateAbbrev state) {
-	Handle state_change_handle;
+	Handle state_change_handle = 0;
 	Result res = 0;
 	res = cecdGetChangeStateEventHandle(&state_change_handle);
 	if (R_FAILED(res)) return res;
+	u64 begin = cecdPlatformTicks();
+	u64 deadline = begin + (u64)CECD_STATE_DEADLINE_MS * CECD_PLATFORM_TICKS_PER_MSEC;
+	bool timed_out = false;
 	res = start ? cecdStart(command) : cecdStop(command);
-	if (R_FAILED(res)) return res;
-	int count = 0;
+	if (R_FAILED(res)) goto cleanup;
 	while (true) {
-		count++;
-		if (count > 20) {
-			return res = -1;
-		}
-		svcWaitSynchronization(state_change_handle, 10e9);
+		// the state might already be there, or the signal might have been for an earlier change
 		CecStateAbbrev is_state;
 		res = cecdGetCecdState(&is_state);
 		if (R_SUCCEEDED(res) && is_state == state) break;
+		u64 now = cecdPlatformTicks();
+		if (now >= deadline) {
+			timed_out = true;
+			res = -1;
+			break;
+		}
+		// a missed signal only costs us one slice instead of the whole wait
+		s64 timeout = (deadline - now) / CECD_PLATFORM_TICKS_PER_MSEC * 1000000;
+		if (timeout > CECD_STATE_SLICE_NS) timeout = CECD_STATE_SLICE_NS;
+		cecdPlatformEventWait(state_change_handle, timeout);
 	}
-	svcCloseHandle(state_change_handle);
+	u32 ms = (cecdPlatformTicks() - begin) / CECD_PLATFORM_TICKS_PER_MSEC;
+	DEBUG_PRINTF("cecd %s %d -> state %d took %lu ms%s\n", start ? "start" : "stop", command, state, (unsigned long)ms, timed_out ? " (timed out)" : "");
+	record_transition(start, command, state, ms, timed_out);
+cleanup:
+	cecdPlatformEventClose(state_change_handle);
 	return res;
 }
 
@@ -71,10 +186,26 @@ void getCurrentTime(CecTimestamp* cts) {
 	cts->weekday = ts->tm_wday;
 }
 
+// the IPC wrappers, cecd_fake.c provides these when building with CECD_FAKE
+#ifndef CECD_FAKE
+static Result cecd_send(u32 path, u32 size) {
+#ifdef CECD_STATS
+	u32 command = getThreadCommandBuffer()[0] >> 16;
+	u64 start = svcGetSystemTick();
+	Result res = svcSendSyncRequest(cecdHandle);
+	cecdStatsRecord(command, path, size, svcGetSystemTick() - start);
+	return res;
+#else
+	return svcSendSyncRequest(cecdHandle);
+#endif
+}
+
 Result cecdInit(void) {
 	Result res = 0;
 
 	if (AtomicPostIncrement(&cecdRefCount)) return 0;
+	cecdSprLockInit();
+	cecdStatsInit();
 
 	res = srvGetServiceHandle(&cecdHandle, "cecd:s");
 	if (R_FAILED(res)) goto cleanup;
@@ -90,7 +221,7 @@ Result cecdGetState(u32* state) {
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x0E, 0, 0);
 	
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	*state = cmdbuf[2];
@@ -99,7 +230,6 @@ Result cecdGetState(u32* state) {
 }
 
 Result cecdReadMessage(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id) {
-	waitForNoSpr();
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x03, 4, 4);
@@ -113,14 +243,16 @@ Result cecdReadMessage(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMes
 	cmdbuf[7] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
 	cmdbuf[8] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	cecdBoxAccessBegin();
+	res = cecd_send(is_outbox, size);
+	cecdBoxAccessEnd();
+	if (R_FAILED(res)) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
 }
 
 Result cecdReadMessageWithHMAC(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id, u8* hmac) {
-	waitForNoSpr();
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x03, 4, 4);
@@ -136,14 +268,16 @@ Result cecdReadMessageWithHMAC(u32 program_id, bool is_outbox, u32 size, u8* buf
 	cmdbuf[9] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
 	cmdbuf[10] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	cecdBoxAccessBegin();
+	res = cecd_send(is_outbox, size);
+	cecdBoxAccessEnd();
+	if (R_FAILED(res)) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
 }
 
 Result cecdWriteMessage(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id) {
-	waitForNoSpr();
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x06, 4, 4);
@@ -157,14 +291,16 @@ Result cecdWriteMessage(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMe
 	cmdbuf[7] = IPC_Desc_Buffer(8, IPC_BUFFER_RW);
 	cmdbuf[8] = (u32)message_id;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	cecdBoxAccessBegin();
+	res = cecd_send(is_outbox, size);
+	cecdBoxAccessEnd();
+	if (R_FAILED(res)) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
 }
 
 Result cecdWriteMessageWithHMAC(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id, u8* hmac) {
-	waitForNoSpr();
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x07, 4, 6);
@@ -180,33 +316,36 @@ Result cecdWriteMessageWithHMAC(u32 program_id, bool is_outbox, u32 size, u8* bu
 	cmdbuf[9] = IPC_Desc_Buffer(8, IPC_BUFFER_RW);
 	cmdbuf[10] = (u32)message_id;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	cecdBoxAccessBegin();
+	res = cecd_send(is_outbox, size);
+	cecdBoxAccessEnd();
+	if (R_FAILED(res)) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
 }
 
 Result cecdStart(CecCommand command) {
-	in_spr_mode = command == CEC_COMMAND_OVER_BOSS || command == CEC_COMMAND_OVER_BOSS_FORCE || command == CEC_COMMAND_OVER_BOSS_FORCE_WAIT;
+	cecdTrackSprMode(command);
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x0B, 1, 0);
 	cmdbuf[1] = command;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
 }
 
 Result cecdStop(CecCommand command) {
-	in_spr_mode = command == CEC_COMMAND_OVER_BOSS || command == CEC_COMMAND_OVER_BOSS_FORCE || command == CEC_COMMAND_OVER_BOSS_FORCE_WAIT;
+	cecdTrackSprMode(command);
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x0C, 1, 0);
 	cmdbuf[1] = command;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -216,7 +355,7 @@ Result cecdGetCecdState(CecStateAbbrev* state) {
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0xE, 0, 0);
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 	*state = cmdbuf[2];
 
@@ -227,7 +366,7 @@ Result cecdGetCecInfoEventHandle(Handle* handle) {
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0xF, 0, 0);
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 	*handle = cmdbuf[3];
 
@@ -238,7 +377,7 @@ Result cecdGetChangeStateEventHandle(Handle* handle) {
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x10, 0, 0);
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 	*handle = cmdbuf[3];
 
@@ -246,7 +385,6 @@ Result cecdGetChangeStateEventHandle(Handle* handle) {
 }
 
 Result cecdOpenAndWrite(u32 program_id, u32 path_type, u32 size, u8* buf) {
-	waitForNoSpr();
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x11, 4, 4);
@@ -260,14 +398,16 @@ Result cecdOpenAndWrite(u32 program_id, u32 path_type, u32 size, u8* buf) {
 	cmdbuf[7] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
 	cmdbuf[8] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	cecdBoxAccessBegin();
+	res = cecd_send(path_type, size);
+	cecdBoxAccessEnd();
+	if (R_FAILED(res)) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
 }
 
 Result cecdOpenAndRead(u32 program_id, u32 path_type, u32 size, u8* buf) {
-	waitForNoSpr();
 	Result res = 0;
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x12, 4, 4);
@@ -281,7 +421,10 @@ Result cecdOpenAndRead(u32 program_id, u32 path_type, u32 size, u8* buf) {
 	cmdbuf[7] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
 	cmdbuf[8] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	cecdBoxAccessBegin();
+	res = cecd_send(path_type, size);
+	cecdBoxAccessEnd();
+	if (R_FAILED(res)) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -292,7 +435,7 @@ Result cecdSprCreate(void) {
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x40A, 0, 0);
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -303,7 +446,7 @@ Result cecdSprInitialise(void) {
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x40B, 0, 0);
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -318,7 +461,7 @@ Result cecdSprGetSlotsMetadata(u32 size, SlotMetadata* buf, u32* slots_total) {
 	cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
 	cmdbuf[3] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, size))) return res;
 	res = (Result)cmdbuf[1];
 	*slots_total = cmdbuf[2];
 
@@ -335,7 +478,7 @@ Result cecdSprGetSlot(u32 title_id, u32 size, u8* buf) {
 	cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
 	cmdbuf[4] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, size))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -348,7 +491,7 @@ Result cecdSprSetTitleSent(u32 title_id, bool success) { // set send result
 	cmdbuf[1] = title_id;
 	cmdbuf[2] = success;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -359,7 +502,7 @@ Result cecdSprFinaliseSend(void) {
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x40F, 0, 0);
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -370,7 +513,7 @@ Result cecdSprStartRecv(void) {
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x410, 0, 0);
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -385,7 +528,7 @@ Result cecdSprAddSlotsMetadata(u32 size, u8* buf) {
 	cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
 	cmdbuf[3] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, size))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -402,7 +545,7 @@ Result cecdSprAddSlot(u32 title_id, u32 size, u8* buf) {
 	cmdbuf[4] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
 	cmdbuf[5] = (u32)buf;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, size))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -413,7 +556,7 @@ Result cecdSprFinaliseRecv(void) {
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x413, 0, 0);
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -425,7 +568,7 @@ Result cecdSprDone(bool success) {
 	cmdbuf[0] = IPC_MakeHeader(0x414, 1, 0);
 	cmdbuf[1] = success;
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -436,7 +579,7 @@ Result cecdGetBossUserid(u64* out) {
 	u32* cmdbuf = getThreadCommandBuffer();
 	cmdbuf[0] = IPC_MakeHeader(0x415, 0, 0);
 
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, 0))) return res;
 	res = (Result)cmdbuf[1];
 	*out = (u64)cmdbuf[2] | ((u64)cmdbuf[3] << 32);
 
@@ -459,7 +602,7 @@ Result cecdGetSystemInfo(u32 destbuf_size, void* destbuf) {
 	cmdbuf[5] = (u32)destbuf;
 
 	
-	if (R_FAILED(res = svcSendSyncRequest(cecdHandle))) return res;
+	if (R_FAILED(res = cecd_send(0, destbuf_size))) return res;
 	res = (Result)cmdbuf[1];
 
 	return res;
@@ -468,89 +611,173 @@ Result cecdGetSystemInfo(u32 destbuf_size, void* destbuf) {
 Handle cecdGetServHandle(void) {
 	return cecdHandle;
 }
+#endif
 
-Result updateStreetpassOutbox(u8* msgbuf) {
+static bool has_message_id(u8* ids, u32 num, u8* id) {
+	for (int i = 0; i < num; i++) {
+		if (!memcmp(ids + sizeof(CecMessageId) * i, id, sizeof(CecMessageId))) return true;
+	}
+	return false;
+}
+
+// rewrites the outbox index if it doesn't hold the same messages as the box info. The order of
+// the index is the order the game sends in, so the messages it already has keep their place
+static Result sync_outbox_index(u32 title_id, CecBoxInfoHeader* boxheader, CecMessageHeader* boxmsgs) {
+	u32 max_num = boxheader->max_num_messages > boxheader->num_messages ? boxheader->max_num_messages : boxheader->num_messages;
+	u32 index_size = 8 + sizeof(CecMessageId) * boxheader->num_messages;
+	u32 cur_size = 8 + sizeof(CecMessageId) * max_num;
+	u8* index = malloc(index_size);
+	u8* cur_index = malloc(cur_size);
+	if (!index || !cur_index) {
+		if (index) free(index);
+		if (cur_index) free(cur_index);
+		return -3;
+	}
+	memset(cur_index, 0, cur_size);
+	CecOBIndex* cur_header = (CecOBIndex*)cur_index;
+	bool cur_ok = R_SUCCEEDED(cecdOpenAndRead(title_id, CEC_PATH_OUTBOX_INDEX, cur_size, cur_index))
+		&& cur_header->magic == 0x6767 && cur_header->num_messages <= max_num;
+	u32 cur_num = cur_ok ? cur_header->num_messages : 0;
+	u8* cur_ids = cur_index + 8;
+
+	CecOBIndex* header = (CecOBIndex*)index;
+	header->magic = 0x6767;
+	header->padding = 0;
+	header->num_messages = 0;
+	u8* ids = index + 8;
+	for (int i = 0; i < cur_num; i++) {
+		u8* id = cur_ids + sizeof(CecMessageId) * i;
+		bool in_box = false;
+		for (int j = 0; j < boxheader->num_messages && !in_box; j++) {
+			in_box = !memcmp(boxmsgs[j].message_id, id, sizeof(CecMessageId));
+		}
+		if (in_box && !has_message_id(ids, header->num_messages, id)) {
+			memcpy(ids + sizeof(CecMessageId) * header->num_messages++, id, sizeof(CecMessageId));
+		}
+	}
+	bool changed = !cur_ok || header->num_messages != cur_num;
+	for (int i = 0; i < boxheader->num_messages; i++) {
+		if (has_message_id(ids, header->num_messages, boxmsgs[i].message_id)) continue;
+		memcpy(ids + sizeof(CecMessageId) * header->num_messages++, boxmsgs[i].message_id, sizeof(CecMessageId));
+		changed = true;
+	}
 	Result res = 0;
-	CecMessageHeader* msgheader = (CecMessageHeader*)msgbuf;
-	// sanity checks
-	if (msgheader->magic != 0x6060) return -1; // bad magic
-	if (msgheader->message_size != msgheader->total_header_size + msgheader->body_size + 0x20) return -1;
-	if (msgheader->message_size > MAX_MESSAGE_SIZE) return -1; // prooobably too large
+	if (changed) {
+		res = cecdOpenAndWrite(title_id, CEC_PATH_OUTBOX_INDEX, 8 + sizeof(CecMessageId) * header->num_messages, index);
+		if (R_FAILED(res)) res = -2;
+	}
+	free(cur_index);
+	free(index);
+	return res;
+}
 
-	// first fetch how large the boxbuf is
-	u8* boxbuf = malloc(sizeof(CecBoxInfoHeader));
-	if (!boxbuf) {
-		return -3;
+Result updateStreetpassOutboxMessages(u32 title_id, u8** msgbufs, int count, Result* results) {
+	Result res = 0;
+	u8* boxbuf = NULL;
+	int num_found = 0;
+	for (int i = 0; i < count; i++) {
+		CecMessageHeader* msgheader = (CecMessageHeader*)msgbufs[i];
+		CecMessageView v;
+		// sanity checks
+		results[i] = cecMessageViewInit(&v, msgbufs[i], MAX_MESSAGE_SIZE) && msgheader->title_id == title_id ? 0 : -1;
 	}
-	res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_OUTBOX_INFO, sizeof(CecBoxInfoHeader), boxbuf);
+
+	// first fetch how large the boxbuf is
+	CecBoxInfoHeader boxinfo;
+	res = cecdOpenAndRead(title_id, CEC_PATH_OUTBOX_INFO, sizeof(CecBoxInfoHeader), (u8*)&boxinfo);
 	if (R_FAILED(res)) {
-		res = -2; // cecd fild not found
-		goto cleanup_box;
+		res = -2; // cecd file not found
+		goto fail;
 	}
-	// let's open the box buffer to update the metadata in there
-	int max_boxbuf_size = sizeof(CecBoxInfoHeader) + sizeof(CecMessageHeader) * ((CecBoxInfoHeader*)boxbuf)->max_num_messages;
-	free(boxbuf);
+	// let's open the box buffer to update the metadata in there, once for the whole batch
+	int max_boxbuf_size = sizeof(CecBoxInfoHeader) + sizeof(CecMessageHeader) * boxinfo.max_num_messages;
 	boxbuf = malloc(max_boxbuf_size);
 	if (!boxbuf) {
-		return -3;
+		res = -3;
+		goto fail;
 	}
-	res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_OUTBOX_INFO, max_boxbuf_size, boxbuf);
+	res = cecdOpenAndRead(title_id, CEC_PATH_OUTBOX_INFO, max_boxbuf_size, boxbuf);
 	if (R_FAILED(res)) {
-		res = -2; // cecd fild not found
-		goto cleanup_box;
+		res = -2; // cecd file not found
+		goto fail;
 	}
 	CecBoxInfoHeader* boxheader = (CecBoxInfoHeader*)boxbuf;
 	CecMessageHeader* boxmsgs = (CecMessageHeader*)(boxbuf + sizeof(CecBoxInfoHeader));
-
-	int found_i = -1;
-	for (int i = 0; i < boxheader->num_messages; i++) {
-		if (0 == memcmp(boxmsgs[i].message_id, msgheader->message_id, sizeof(CecMessageId))){
-			found_i = i;
-			break;
+	if (boxheader->num_messages > boxinfo.max_num_messages) boxheader->num_messages = boxinfo.max_num_messages;
+
+	for (int i = 0; i < count; i++) {
+		if (results[i]) continue;
+		CecMessageHeader* msgheader = (CecMessageHeader*)msgbufs[i];
+		int found_i = -1;
+		for (int j = 0; j < boxheader->num_messages; j++) {
+			if (0 == memcmp(boxmsgs[j].message_id, msgheader->message_id, sizeof(CecMessageId))) {
+				found_i = j;
+				break;
+			}
 		}
+		if (found_i < 0) {
+			results[i] = -4; // not found
+			continue;
+		}
+		// the box tracks the total size of its messages, which the new version may change
+		boxheader->box_size += msgheader->message_size - boxmsgs[found_i].message_size;
+		memcpy(&boxmsgs[found_i], msgheader, sizeof(CecMessageHeader));
+		num_found++;
 	}
-	if (found_i < 0) {
-		res = -4; // not found
-		goto cleanup_box;
-	}
-	memcpy(&boxmsgs[found_i], msgheader, sizeof(CecMessageHeader));
+	if (!num_found) goto cleanup;
 
-	res = cecdOpenAndWrite(msgheader->title_id, CEC_PATH_OUTBOX_INFO, boxheader->file_size, boxbuf);
+	res = cecdOpenAndWrite(title_id, CEC_PATH_OUTBOX_INFO, boxheader->file_size, boxbuf);
 	if (R_FAILED(res)) {
-		res = -2; // cecd fild not found
-		goto cleanup_box;
+		res = -2; // cecd file not found
+		goto fail;
 	}
-	free(boxbuf);
 
-	// now let's fetch the hmac and store the update
+	// now let's fetch the hmac and store the updates
 	CecMBoxInfoHeader mboxheader;
-	res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
-	if (R_FAILED(res)) return -2;
-
-	// great,we have all the bits we need now
-	res = cecdWriteMessageWithHMAC(
-		msgheader->title_id, true,
-		msgheader->message_size, msgbuf,
-		msgheader->message_id, mboxheader.hmac_key);
-	if (R_FAILED(res)) return res;
+	res = cecdOpenAndRead(title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
+	if (R_FAILED(res)) {
+		res = -2;
+		goto fail;
+	}
 
+	// great, we have all the bits we need now
+	for (int i = 0; i < count; i++) {
+		if (results[i]) continue;
+		CecMessageHeader* msgheader = (CecMessageHeader*)msgbufs[i];
+		results[i] = cecdWriteMessageWithHMAC(
+			title_id, true,
+			msgheader->message_size, msgbufs[i],
+			msgheader->message_id, mboxheader.hmac_key);
+	}
+
+	res = sync_outbox_index(title_id, boxheader, boxmsgs);
+	goto cleanup;
+fail:
+	for (int i = 0; i < count; i++) {
+		if (results[i] == 0) results[i] = res;
+	}
+cleanup:
+	if (boxbuf) free(boxbuf);
 	return res;
-cleanup_box:
-	free(boxbuf);
+}
+
+Result updateStreetpassOutbox(u8* msgbuf) {
+	Result res = 0;
+	u32 title_id = ((CecMessageHeader*)msgbuf)->title_id;
+	Result r = updateStreetpassOutboxMessages(title_id, &msgbuf, 1, &res);
+	if (R_FAILED(r) && R_SUCCEEDED(res)) return r;
 	return res;
 }
 
 bool validateStreetpassMessage(u8* msgbuf) {
-	CecMessageHeader* msgheader = (CecMessageHeader*)msgbuf;
 	// sanity checks
-	if (msgheader->magic != 0x6060) return false; // bad magic
-	if (msgheader->message_size != msgheader->total_header_size + msgheader->body_size + 0x20) return false;
-	if (msgheader->message_size > MAX_MESSAGE_SIZE) return false; // prooobably too large
+	CecMessageView v;
+	if (!cecMessageViewInit(&v, msgbuf, MAX_MESSAGE_SIZE)) return false;
 
-	if (msgheader->body_size <= 0x20) {
+	if (v.body_size <= 0x20) {
 		u8 b = 0;
-		u8* ptr = msgbuf + msgheader->total_header_size;
-		for (int i = 0; i < msgheader->body_size; i++) {
+		u8* ptr = v.body;
+		for (int i = 0; i < v.body_size; i++) {
 			b |= *ptr;
 			ptr++;
 		}
@@ -560,141 +787,200 @@ bool validateStreetpassMessage(u8* msgbuf) {
 	return true;
 }
 
-Result addStreetpassMessage(u8* msgbuf) {
+// adds all messages of one title, the indexes in idx point into msgbufs and results
+static Result add_title_messages(u32 title_id, u8** msgbufs, int* idx, int count, Result* results) {
 	Result res = 0;
-	CecMessageHeader* msgheader = (CecMessageHeader*)msgbuf;
-	// sanity checks
-	if (!validateStreetpassMessage(msgbuf)) return -1; // bad message
-
-	// update the msg header about the receive time
-	if (!msgheader->received.year) {
-		getCurrentTime(&(msgheader->received));
-	}
+	u8* boxbuf = NULL;
+	int num_written = 0;
 
 	// first fetch how large the boxbuf is
-	u8* boxbuf = malloc(sizeof(CecBoxInfoHeader));
-	if (!boxbuf) {
-		return -3;
-	}
-	res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_INBOX_INFO, sizeof(CecBoxInfoHeader), boxbuf);
+	CecBoxInfoHeader boxinfo;
+	res = cecdOpenAndRead(title_id, CEC_PATH_INBOX_INFO, sizeof(CecBoxInfoHeader), (u8*)&boxinfo);
 	if (R_FAILED(res)) {
-		res = -2; // cecd fild not found
-		goto cleanup_box;
+		res = -2; // cecd file not found
+		goto fail;
 	}
-	// let's open the box buffer to see if we can even accept a new message, or if the message has already been accepted
-	int max_boxbuf_size = sizeof(CecBoxInfoHeader) + sizeof(CecMessageHeader) * ((CecBoxInfoHeader*)boxbuf)->max_num_messages;
-	free(boxbuf);
+	// one read of the box tells us about duplicates and space for the whole batch
+	int max_boxbuf_size = sizeof(CecBoxInfoHeader) + sizeof(CecMessageHeader) * boxinfo.max_num_messages;
 	boxbuf = malloc(max_boxbuf_size);
 	if (!boxbuf) {
-		return -3;
+		res = -3;
+		goto fail;
 	}
-	res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_INBOX_INFO, max_boxbuf_size, boxbuf);
+	res = cecdOpenAndRead(title_id, CEC_PATH_INBOX_INFO, max_boxbuf_size, boxbuf);
 	if (R_FAILED(res)) {
 		res = -2; // cecd file not found
-		goto cleanup_box;
+		goto fail;
 	}
 	CecBoxInfoHeader* boxheader = (CecBoxInfoHeader*)boxbuf;
 	CecMessageHeader* boxmsgs = (CecMessageHeader*)(boxbuf + sizeof(CecBoxInfoHeader));
+	// what the box will look like after the batch, to check the limits against
+	u32 num_messages = boxheader->num_messages;
+	u32 box_size = boxheader->box_size;
 
-	for (int i = 0; i < boxheader->num_messages; i++) {
-		if (0 == memcmp(boxmsgs[i].message_id, msgheader->message_id, sizeof(CecMessageId))){
-			res = -4; // already added, nothing to do
-			goto cleanup_box;
-		}
-	}
-	if (boxheader->num_messages >= boxheader->max_num_messages) {
-		res = -5; // box already full
-		goto cleanup_box;
-	}
-
-	// let's see if the message is too large for this box
-	if (boxheader->max_message_size < msgheader->message_size) {
-		res = -1;
-		goto cleanup_box;
-	}
-
-	// now let's check if the box would overflow
-	if (boxheader->box_size + msgheader->message_size > boxheader->max_box_size) {
-		res = -1;
-		goto cleanup_box;
+	// box stuffs is done, let's fetch the mbox, to fetch the hmac key
+	CecMBoxInfoHeader mboxheader;
+	res = cecdOpenAndRead(title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
+	if (R_FAILED(res)) {
+		res = -2;
+		goto fail;
 	}
 
-	// cool, the checks passed. Let's free the buffer for now, add our message, and then check if we gotta update the box
-	free(boxbuf);
-
-	{
-		// box stuffs is done, let's fetch the mbox, to fetch the hmac key
-		CecMBoxInfoHeader mboxheader;
-		res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
-		if (R_FAILED(res)) return -2;
+	for (int i = 0; i < count; i++) {
+		CecMessageHeader* msgheader = (CecMessageHeader*)msgbufs[idx[i]];
+		Result* r = &results[idx[i]];
+		bool dupe = false;
+		for (int j = 0; j < boxheader->num_messages; j++) {
+			if (0 == memcmp(boxmsgs[j].message_id, msgheader->message_id, sizeof(CecMessageId))) {
+				dupe = true;
+				break;
+			}
+		}
+		for (int j = 0; j < i && !dupe; j++) {
+			CecMessageHeader* other = (CecMessageHeader*)msgbufs[idx[j]];
+			if (results[idx[j]] == 0 && 0 == memcmp(other->message_id, msgheader->message_id, sizeof(CecMessageId))) {
+				dupe = true;
+			}
+		}
+		if (dupe) {
+			*r = -4; // already added, nothing to do
+			seenAdd(SEEN_INBOX, title_id, msgheader->message_id);
+			continue;
+		}
+		if (num_messages >= boxheader->max_num_messages) {
+			*r = -5; // box already full
+			continue;
+		}
+		// let's see if the message is too large for this box, or if the box would overflow
+		if (boxheader->max_message_size < msgheader->message_size || box_size + msgheader->message_size > boxheader->max_box_size) {
+			*r = -1;
+			continue;
+		}
 
+		// update the msg header about the receive time
+		if (!msgheader->received.year) {
+			getCurrentTime(&(msgheader->received));
+		}
 		msgheader->unopened = true;
 		msgheader->new_flag = true;
-		// great,we have all the bits we need now
-		res = cecdWriteMessageWithHMAC(
-			msgheader->title_id, false,
-			msgheader->message_size, msgbuf,
+		*r = cecdWriteMessageWithHMAC(
+			title_id, false,
+			msgheader->message_size, (u8*)msgheader,
 			msgheader->message_id, mboxheader.hmac_key);
-		if (R_FAILED(res)) return res;
-
-		// check if the message was actually added...
-		res = cecdReadMessage(msgheader->title_id, false, 0, 0, msgheader->message_id);
-		if (R_FAILED(res)) return res;
+		if (R_FAILED(*r)) continue;
+		// check if the message was actually added, else it mustn't end up in the box info below
+		*r = cecdReadMessage(title_id, false, 0, 0, msgheader->message_id);
+		if (R_FAILED(*r)) continue;
+		num_messages++;
+		box_size += msgheader->message_size;
+		num_written++;
 	}
+	if (!num_written) goto cleanup;
 
-	// let's see if we gotta update the metadata
-	boxbuf = malloc(max_boxbuf_size);
-	if (!boxbuf) {
-		return -3;
-	}
-	res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_INBOX_INFO, max_boxbuf_size, boxbuf);
+	// cecd may or may not have added the messages to the box itself, so we check once for the whole batch
+	memset(boxbuf, 0, max_boxbuf_size);
+	res = cecdOpenAndRead(title_id, CEC_PATH_INBOX_INFO, max_boxbuf_size, boxbuf);
 	if (R_FAILED(res)) {
-		res = -2; // cecd fild not found
-		goto cleanup_box;
+		res = -2; // cecd file not found
+		goto fail;
 	}
-
-	boxheader = (CecBoxInfoHeader*)boxbuf;
-	boxmsgs = (CecMessageHeader*)(boxbuf + sizeof(CecBoxInfoHeader));
-	bool found_box = false;
-	for (int i = 0; i < boxheader->num_messages; i++) {
-		if (0 == memcmp(boxmsgs[i].message_id, msgheader->message_id, sizeof(CecMessageId))){
-			found_box = true;
-			break;
+	bool box_edited = false;
+	for (int i = 0; i < count; i++) {
+		if (results[idx[i]] != 0) continue;
+		CecMessageHeader* msgheader = (CecMessageHeader*)msgbufs[idx[i]];
+		bool found_box = false;
+		for (int j = 0; j < boxheader->num_messages; j++) {
+			if (0 == memcmp(boxmsgs[j].message_id, msgheader->message_id, sizeof(CecMessageId))) {
+				found_box = true;
+				break;
+			}
+		}
+		if (!found_box && boxheader->num_messages < boxheader->max_num_messages) {
+			// ok, let's add the message to the box
+			memcpy(&boxmsgs[boxheader->num_messages], msgheader, sizeof(CecMessageHeader));
+			boxheader->num_messages++;
+			boxheader->file_size += sizeof(CecMessageHeader);
+			boxheader->box_size += msgheader->message_size;
+			box_edited = true;
 		}
+		seenAdd(SEEN_INBOX, title_id, msgheader->message_id);
 	}
-	
-	if (!found_box) {
-		// ok, let's add the message to the box
-		memcpy(boxbuf + sizeof(CecBoxInfoHeader) + sizeof(CecMessageHeader) * ((CecBoxInfoHeader*)boxbuf)->num_messages, msgbuf, sizeof(CecMessageHeader));
-		boxheader->num_messages++;
-		boxheader->file_size += sizeof(CecMessageHeader);
-		boxheader->box_size += msgheader->message_size;
-		res = cecdOpenAndWrite(msgheader->title_id, CEC_PATH_INBOX_INFO, boxheader->file_size, boxbuf);
+	if (box_edited) {
+		res = cecdOpenAndWrite(title_id, CEC_PATH_INBOX_INFO, boxheader->file_size, boxbuf);
 		if (R_FAILED(res)) {
-			res = -2; // cecd fild not found
-			goto cleanup_box;
+			res = -2; // cecd file not found
+			goto fail;
 		}
-		free(boxbuf);
 	}
 
-
-	{
-		// now set the green notification dot
-		// gotta re-fetch the mbox header, in case it changed
-		CecMBoxInfoHeader mboxheader;
-		res = cecdOpenAndRead(msgheader->title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
-		if (R_FAILED(res)) return -2;
-
-		getCurrentTime(&(mboxheader.last_received));
-		mboxheader.flag_unread = 1; // set the new notification dot
-		mboxheader.flag_new = 1;
-
-		res = cecdOpenAndWrite(msgheader->title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
-		if (R_FAILED(res)) return -2;
+	// now set the green notification dot, once for the whole batch.
+	// cecd updates the mbox info while writing the messages, so we gotta re-fetch it
+	res = cecdOpenAndRead(title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
+	if (R_FAILED(res)) {
+		res = -2;
+		goto fail;
+	}
+	getCurrentTime(&(mboxheader.last_received));
+	mboxheader.flag_unread = 1; // set the new notification dot
+	mboxheader.flag_new = 1;
+	res = cecdOpenAndWrite(title_id, CEC_PATH_MBOX_INFO, sizeof(CecMBoxInfoHeader), (u8*)&mboxheader);
+	if (R_FAILED(res)) res = -2;
+	goto cleanup;
+fail:
+	for (int i = 0; i < count; i++) {
+		if (results[idx[i]] == 0) results[idx[i]] = res;
 	}
+cleanup:
+	if (boxbuf) free(boxbuf);
+	return res;
+}
 
+Result addStreetpassMessages(u8** msgbufs, int count, Result* results) {
+	Result res = 0;
+	int* idx = malloc(sizeof(int) * count);
+	if (!idx) return -3;
+	bool* done = malloc(sizeof(bool) * count);
+	if (!done) {
+		free(idx);
+		return -3;
+	}
+	for (int i = 0; i < count; i++) {
+		CecMessageHeader* msgheader = (CecMessageHeader*)msgbufs[i];
+		results[i] = 0;
+		done[i] = true;
+		// sanity checks
+		if (!validateStreetpassMessage(msgbufs[i])) {
+			results[i] = -1; // bad message
+		} else if (seenContains(SEEN_INBOX, msgheader->title_id, msgheader->message_id)) {
+			results[i] = -4; // already added, without asking cecd
+		} else {
+			done[i] = false;
+		}
+	}
+	// group the messages by title, so that every box is only read and written once
+	for (int i = 0; i < count; i++) {
+		if (done[i]) continue;
+		u32 title_id = ((CecMessageHeader*)msgbufs[i])->title_id;
+		int num = 0;
+		for (int j = i; j < count; j++) {
+			if (!done[j] && ((CecMessageHeader*)msgbufs[j])->title_id == title_id) {
+				idx[num++] = j;
+				done[j] = true;
+			}
+		}
+		Result r = add_title_messages(title_id, msgbufs, idx, num, results);
+		if (R_FAILED(r)) res = r;
+	}
+	// one write to the SD card for the whole batch
+	seenFlush();
+	free(done);
+	free(idx);
 	return res;
-cleanup_box:
-	free(boxbuf);
+}
+
+Result addStreetpassMessage(u8* msgbuf) {
+	Result res = 0;
+	Result r = addStreetpassMessages(&msgbuf, 1, &res);
+	if (R_FAILED(r) && R_SUCCEEDED(res)) return r;
 	return res;
 }
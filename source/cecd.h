@@ -17,8 +17,7 @@
  */
 
 #pragma once
-#include <3ds.h>
-#include <3ds/types.h>
+#include "cecd_platform.h"
 
 typedef enum {
 	TITLE_LETTER_BOX     = 0x051600,
@@ -86,7 +85,42 @@ typedef struct SlotMetadata {
 	u32 size;
 } SlotMetadata;
 
+// how long a state transition may take in total, and how long we sleep at most between state checks.
+// The deadline is the same 20 times 10 seconds we always allowed, entering OVER_BOSS can be that slow
+#define CECD_STATE_DEADLINE_MS 200000
+#define CECD_STATE_SLICE_NS ((s64)500*1000000)
+#define CECD_MAX_TRANSITION_STATS 8
+
+typedef struct {
+	bool start;
+	int command;
+	CecStateAbbrev state;
+	u32 count;
+	u32 timeouts;
+	u32 total_ms;
+	u32 min_ms;
+	u32 max_ms;
+} CecdTransitionStats;
+
 Result waitForCecdState(bool start, int command, CecStateAbbrev state);
+// returns the number of transitions filled into stats
+int cecdGetTransitionStats(CecdTransitionStats* stats, int max);
+typedef struct {
+	u32 shared_waits; // box and message access that had to wait for an SPR session
+	u32 shared_wait_total_ms;
+	u32 shared_wait_max_ms;
+	u32 exclusive_waits; // SPR sessions that had to wait for box access to finish
+	u32 exclusive_wait_total_ms;
+	u32 exclusive_wait_max_ms;
+} CecdSprLockStats;
+
+void cecdSprLockInit(void);
+// box and message access is shared, SPR sessions are exclusive
+void cecdBoxAccessBegin(void);
+void cecdBoxAccessEnd(void);
+// enters or leaves SPR mode depending on the command, taking or releasing exclusive access
+void cecdTrackSprMode(CecCommand command);
+void cecdGetSprLockStats(CecdSprLockStats* stats);
 Result cecdInit(void);
 Result cecdGetState(u32* state);
 Result cecdGetSystemInfo(u32 destbuf_size, void* destbuf);
@@ -116,8 +150,15 @@ Result cecdGetBossUserid(u64* out);
 Handle cecdGetServHandle(void);
 
 Result updateStreetpassOutbox(u8* msgbuf);
+// replaces many messages in one title's outbox, matched by message id. The box info is written and
+// the hmac key fetched once per batch, and the outbox index is fixed up if it doesn't match the box.
+// results gets the result of each message, same as updateStreetpassOutbox would return for it
+Result updateStreetpassOutboxMessages(u32 title_id, u8** msgbufs, int count, Result* results);
 bool validateStreetpassMessage(u8* msgbuf);
 Result addStreetpassMessage(u8* msgbuf);
+// adds many messages at once, reading and writing each title's box only once. results gets the
+// result of each message, same as addStreetpassMessage would return for it
+Result addStreetpassMessages(u8** msgbufs, int count, Result* results);
 
 typedef struct {
 	u32 magic; // 0x42504643 CFPB
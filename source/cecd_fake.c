@@ -0,0 +1,423 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef CECD_FAKE
+
+#include "cecd_fake.h"
+#include "cecd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define FAKE_ERR_NOT_FOUND MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_APPLICATION, RD_NOT_FOUND)
+#define FAKE_ERR_INVALID MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_APPLICATION, RD_NO_DATA)
+
+static char fake_root[100] = CECD_FAKE_DEFAULT_ROOT;
+static u32 latencies[NUM_CECD_FAKE_CMDS] = {0};
+static const char* latency_names[NUM_CECD_FAKE_CMDS] = {
+	"open_and_read",
+	"open_and_write",
+	"read_message",
+	"write_message",
+	"start",
+	"stop",
+	"get_state",
+	"get_event",
+	"spr_get_slots_metadata",
+	"spr_get_slot",
+	"spr_add_slot",
+	"spr_other",
+	"other",
+};
+
+static s32 cecdRefCount;
+static CecStateAbbrev cur_state = CEC_STATE_ABBREV_IDLE;
+static Handle state_event = 0;
+static Handle info_event = 0;
+
+void cecdFakeSetRoot(const char* root) {
+	snprintf(fake_root, sizeof(fake_root), "%s", root);
+}
+
+void cecdFakeSetLatency(CecdFakeCommand cmd, u32 usec) {
+	if (cmd < NUM_CECD_FAKE_CMDS) latencies[cmd] = usec;
+}
+
+void cecdFakeLoadLatencies(const char* path) {
+	FILE* f = fopen(path, "r");
+	if (!f) return;
+	char line[100];
+	while (fgets(line, sizeof(line), f)) {
+		char* value = strchr(line, '=');
+		if (!value) continue;
+		*value++ = '\0';
+		for (int i = 0; i < NUM_CECD_FAKE_CMDS; i++) {
+			if (strcmp(line, latency_names[i]) == 0) {
+				latencies[i] = strtoul(value, NULL, 10);
+				break;
+			}
+		}
+	}
+	fclose(f);
+}
+
+static void fake_latency(CecdFakeCommand cmd) {
+	if (latencies[cmd]) cecdPlatformSleep((u64)latencies[cmd] * 1000);
+}
+
+static bool fake_path(char* out, size_t len, u32 title_id, u32 path_type) {
+	switch (path_type) {
+		case CEC_PATH_MBOX_LIST:
+			snprintf(out, len, "%sMBoxList____", fake_root);
+			return true;
+		case CEC_PATH_MBOX_INFO:
+			snprintf(out, len, "%s%08lx/MBoxInfo____", fake_root, (unsigned long)title_id);
+			return true;
+		case CEC_PATH_INBOX_INFO:
+			snprintf(out, len, "%s%08lx/InBox___/BoxInfo_____", fake_root, (unsigned long)title_id);
+			return true;
+		case CEC_PATH_OUTBOX_INFO:
+			snprintf(out, len, "%s%08lx/OutBox__/BoxInfo_____", fake_root, (unsigned long)title_id);
+			return true;
+		case CEC_PATH_OUTBOX_INDEX:
+			snprintf(out, len, "%s%08lx/OutBox__/OBIndex_____", fake_root, (unsigned long)title_id);
+			return true;
+	}
+	if (path_type >= 100 && path_type < 200) {
+		snprintf(out, len, "%s%08lx/MBoxData.%03lu", fake_root, (unsigned long)title_id, (unsigned long)(path_type - 100));
+		return true;
+	}
+	return false;
+}
+
+static void fake_message_path(char* out, size_t len, u32 title_id, bool is_outbox, CecMessageId message_id) {
+	int pos = snprintf(out, len, "%s%08lx/%s/_", fake_root, (unsigned long)title_id, is_outbox ? "OutBox__" : "InBox___");
+	for (int i = 0; i < sizeof(CecMessageId) && pos < len; i++) {
+		pos += snprintf(out + pos, len - pos, "%02x", message_id[i]);
+	}
+}
+
+// creates every directory leading up to the last slash of the path
+static void make_dirs(const char* orig_path) {
+	char path[150];
+	snprintf(path, sizeof(path), "%s", orig_path);
+	for (char* found = strchr(path + 1, '/'); found; found = strchr(found + 1, '/')) {
+		*found = '\0';
+		mkdir(path, 0777);
+		*found = '/';
+	}
+}
+
+// returns the number of bytes read, or -1 if the file doesn't exist. The files are read and
+// written in one go, so that the injected latency is all there is to the cost of a command
+static int read_file(const char* path, u32 size, u8* buf) {
+	FILE* f = fopen(path, "rb");
+	if (!f) return -1;
+	int read = size && buf ? fread(buf, 1, size, f) : 0;
+	fclose(f);
+	return read;
+}
+
+static Result write_file(const char* path, u32 size, u8* buf) {
+	make_dirs(path);
+	FILE* f = fopen(path, "wb");
+	if (!f) return FAKE_ERR_INVALID;
+	size_t written = fwrite(buf, size, 1, f);
+	fclose(f);
+	return written == 1 ? 0 : FAKE_ERR_INVALID;
+}
+
+static void set_state(CecStateAbbrev state) {
+	cur_state = state;
+	if (state_event) cecdPlatformEventSignal(state_event);
+}
+
+Result cecdInit(void) {
+	if (cecdPlatformAtomicIncrement(&cecdRefCount)) return 0;
+	cecdSprLockInit();
+	make_dirs(fake_root);
+	char path[150];
+	snprintf(path, sizeof(path), "%slatency.txt", fake_root);
+	cecdFakeLoadLatencies(path);
+	cecdPlatformEventCreate(&state_event);
+	cecdPlatformEventCreate(&info_event);
+	printf("Using fake cecd in %s\n", fake_root);
+	return 0;
+}
+
+Result cecdGetState(u32* state) {
+	fake_latency(CECD_FAKE_CMD_GET_STATE);
+	*state = cur_state;
+	return 0;
+}
+
+Result cecdGetCecdState(CecStateAbbrev* state) {
+	fake_latency(CECD_FAKE_CMD_GET_STATE);
+	*state = cur_state;
+	return 0;
+}
+
+Result cecdReadMessage(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id) {
+	cecdBoxAccessBegin();
+	fake_latency(CECD_FAKE_CMD_READ_MESSAGE);
+	char path[150];
+	fake_message_path(path, sizeof(path), program_id, is_outbox, message_id);
+	Result res = read_file(path, size, buf) < 0 ? FAKE_ERR_NOT_FOUND : 0;
+	cecdBoxAccessEnd();
+	return res;
+}
+
+Result cecdReadMessageWithHMAC(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id, u8* hmac) {
+	// the hmac isn't verified, there is no signature in the fake files
+	return cecdReadMessage(program_id, is_outbox, size, buf, message_id);
+}
+
+Result cecdWriteMessage(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id) {
+	cecdBoxAccessBegin();
+	fake_latency(CECD_FAKE_CMD_WRITE_MESSAGE);
+	char path[150];
+	fake_message_path(path, sizeof(path), program_id, is_outbox, message_id);
+	Result res = write_file(path, size, buf);
+	cecdBoxAccessEnd();
+	return res;
+}
+
+Result cecdWriteMessageWithHMAC(u32 program_id, bool is_outbox, u32 size, u8* buf, CecMessageId message_id, u8* hmac) {
+	return cecdWriteMessage(program_id, is_outbox, size, buf, message_id);
+}
+
+Result cecdStart(CecCommand command) {
+	cecdTrackSprMode(command);
+	fake_latency(CECD_FAKE_CMD_START);
+	if (command == CEC_COMMAND_STOP || command == CEC_COMMAND_STOP_FORCE || command == CEC_COMMAND_STOP_FORCE_WAIT) {
+		set_state(CEC_STATE_ABBREV_IDLE);
+	} else {
+		set_state(CEC_STATE_ABBREV_SCANNING);
+	}
+	return 0;
+}
+
+Result cecdStop(CecCommand command) {
+	cecdTrackSprMode(command);
+	fake_latency(CECD_FAKE_CMD_STOP);
+	set_state(CEC_STATE_ABBREV_INACTIVE);
+	return 0;
+}
+
+Result cecdGetCecInfoEventHandle(Handle* handle) {
+	fake_latency(CECD_FAKE_CMD_GET_EVENT);
+	return cecdPlatformEventDuplicate(handle, info_event);
+}
+
+Result cecdGetChangeStateEventHandle(Handle* handle) {
+	fake_latency(CECD_FAKE_CMD_GET_EVENT);
+	return cecdPlatformEventDuplicate(handle, state_event);
+}
+
+Result cecdOpenAndWrite(u32 program_id, u32 path_type, u32 size, u8* buf) {
+	char path[150];
+	if (!fake_path(path, sizeof(path), program_id, path_type)) return FAKE_ERR_INVALID;
+	cecdBoxAccessBegin();
+	fake_latency(CECD_FAKE_CMD_OPEN_AND_WRITE);
+	Result res = write_file(path, size, buf);
+	cecdBoxAccessEnd();
+	if (R_SUCCEEDED(res) && info_event) cecdPlatformEventSignal(info_event);
+	return res;
+}
+
+Result cecdOpenAndRead(u32 program_id, u32 path_type, u32 size, u8* buf) {
+	char path[150];
+	if (!fake_path(path, sizeof(path), program_id, path_type)) return FAKE_ERR_INVALID;
+	cecdBoxAccessBegin();
+	fake_latency(CECD_FAKE_CMD_OPEN_AND_READ);
+	Result res = read_file(path, size, buf) < 0 ? FAKE_ERR_NOT_FOUND : 0;
+	cecdBoxAccessEnd();
+	return res;
+}
+
+Result cecdSprCreate(void) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+Result cecdSprInitialise(void) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+// builds the outgoing slot of a title from its outbox. Returns the slot size, 0 if there is nothing to send
+static u32 build_slot(u32 title_id, u8* buf, u32 max_size, int* send_method) {
+	*send_method = 1; // receive only, unless we find something to send
+	char path[150];
+	fake_path(path, sizeof(path), title_id, CEC_PATH_OUTBOX_INFO);
+	CecBoxInfoHeader header;
+	if (read_file(path, sizeof(CecBoxInfoHeader), (u8*)&header) != sizeof(CecBoxInfoHeader) || !header.num_messages) return 0;
+	u32 box_size = sizeof(CecBoxInfoHeader) + header.num_messages * sizeof(CecMessageHeader);
+	CecBoxInfoHeader* box = malloc(box_size);
+	if (!box) return 0;
+	if (read_file(path, box_size, (u8*)box) != box_size) {
+		free(box);
+		return 0;
+	}
+	CecMessageHeader* msgs = (CecMessageHeader*)(box + 1);
+	*send_method = msgs[0].send_method;
+	CecSlotHeader slot = {
+		magic: 0x6161,
+		size: sizeof(CecSlotHeader),
+		title_id: title_id,
+		batch_id: msgs[0].batch_id,
+		message_count: 0,
+	};
+	for (int i = 0; i < header.num_messages; i++) {
+		u32 msg_size = msgs[i].message_size;
+		if (slot.size + msg_size > max_size) break;
+		if (buf) {
+			fake_message_path(path, sizeof(path), title_id, true, msgs[i].message_id);
+			if (read_file(path, msg_size, buf + slot.size) != msg_size) continue;
+		}
+		slot.size += msg_size;
+		slot.message_count++;
+	}
+	free(box);
+	if (!slot.message_count) return 0;
+	if (buf) memcpy(buf, &slot, sizeof(CecSlotHeader));
+	return slot.size;
+}
+
+Result cecdSprGetSlotsMetadata(u32 size, SlotMetadata* buf, u32* slots_total) {
+	fake_latency(CECD_FAKE_CMD_SPR_GET_SLOTS_METADATA);
+	*slots_total = 0;
+	char path[150];
+	fake_path(path, sizeof(path), 0, CEC_PATH_MBOX_LIST);
+	CecMboxListHeader mbox_list;
+	if (read_file(path, sizeof(CecMboxListHeader), (u8*)&mbox_list) != sizeof(CecMboxListHeader)) return FAKE_ERR_NOT_FOUND;
+	u32 max_slots = size / sizeof(SlotMetadata);
+	for (int i = 0; i < mbox_list.num_boxes && *slots_total < max_slots; i++) {
+		u32 title_id = strtol((const char*)mbox_list.box_names[i], NULL, 16);
+		SlotMetadata* m = &buf[*slots_total];
+		m->title_id = title_id;
+		m->size = build_slot(title_id, NULL, MAX_SLOT_SIZE, &m->send_method);
+		(*slots_total)++;
+	}
+	return 0;
+}
+
+Result cecdSprGetSlot(u32 title_id, u32 size, u8* buf) {
+	fake_latency(CECD_FAKE_CMD_SPR_GET_SLOT);
+	int send_method;
+	return build_slot(title_id, buf, size, &send_method) ? 0 : FAKE_ERR_NOT_FOUND;
+}
+
+Result cecdSprSetTitleSent(u32 title_id, bool success) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+Result cecdSprFinaliseSend(void) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+Result cecdSprStartRecv(void) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+Result cecdSprAddSlotsMetadata(u32 size, u8* buf) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+// what cecd does on receiving a slot: store the messages and append them to the inbox
+Result cecdSprAddSlot(u32 title_id, u32 size, u8* buf) {
+	fake_latency(CECD_FAKE_CMD_SPR_ADD_SLOT);
+	if (size < sizeof(CecSlotHeader)) return FAKE_ERR_INVALID;
+	char path[150];
+	fake_path(path, sizeof(path), title_id, CEC_PATH_INBOX_INFO);
+	CecBoxInfoHeader header;
+	if (read_file(path, sizeof(CecBoxInfoHeader), (u8*)&header) != sizeof(CecBoxInfoHeader)) return FAKE_ERR_NOT_FOUND;
+	u32 box_size = sizeof(CecBoxInfoHeader) + header.max_num_messages * sizeof(CecMessageHeader);
+	u8* box = malloc(box_size);
+	if (!box) return FAKE_ERR_INVALID;
+	memset(box, 0, box_size);
+	read_file(path, box_size, box);
+	CecBoxInfoHeader* boxheader = (CecBoxInfoHeader*)box;
+	CecMessageHeader* boxmsgs = (CecMessageHeader*)(box + sizeof(CecBoxInfoHeader));
+
+	CecSlotHeader* slot = (CecSlotHeader*)buf;
+	u8* ptr = buf + sizeof(CecSlotHeader);
+	u8* end = buf + size;
+	bool added = false;
+	for (int i = 0; i < slot->message_count; i++) {
+		CecMessageHeader* msg = (CecMessageHeader*)ptr;
+		if (ptr + sizeof(CecMessageHeader) > end || msg->message_size < sizeof(CecMessageHeader) || ptr + msg->message_size > end) break;
+		ptr += msg->message_size;
+		bool exists = false;
+		for (int j = 0; j < boxheader->num_messages; j++) {
+			if (memcmp(boxmsgs[j].message_id, msg->message_id, sizeof(CecMessageId)) == 0) {
+				exists = true;
+				break;
+			}
+		}
+		if (exists || boxheader->num_messages >= boxheader->max_num_messages) continue;
+		if (boxheader->box_size + msg->message_size > boxheader->max_box_size) continue;
+		char msg_path[150];
+		fake_message_path(msg_path, sizeof(msg_path), title_id, false, msg->message_id);
+		if (R_FAILED(write_file(msg_path, msg->message_size, (u8*)msg))) continue;
+		memcpy(&boxmsgs[boxheader->num_messages], msg, sizeof(CecMessageHeader));
+		boxheader->num_messages++;
+		boxheader->file_size += sizeof(CecMessageHeader);
+		boxheader->box_size += msg->message_size;
+		added = true;
+	}
+	Result res = 0;
+	if (added) {
+		res = write_file(path, boxheader->file_size, box);
+		if (info_event) cecdPlatformEventSignal(info_event);
+	}
+	free(box);
+	return res;
+}
+
+Result cecdSprFinaliseRecv(void) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+Result cecdSprDone(bool success) {
+	fake_latency(CECD_FAKE_CMD_SPR_OTHER);
+	return 0;
+}
+
+Result cecdGetBossUserid(u64* out) {
+	fake_latency(CECD_FAKE_CMD_OTHER);
+	*out = 0x4E45545041535321; // "NETPASS!"
+	return 0;
+}
+
+Result cecdGetSystemInfo(u32 destbuf_size, void* destbuf) {
+	fake_latency(CECD_FAKE_CMD_OTHER);
+	return FAKE_ERR_INVALID;
+}
+
+Handle cecdGetServHandle(void) {
+	return 0;
+}
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cecd_platform.h"
+
+// Build with CECD_FAKE=1 to replace the cecd:s IPC wrappers in cecd.c with an
+// emulation on top of a directory tree. host/Makefile builds the same on Linux, with
+// the root given on the command line. The tree is laid out like the CEC savedata:
+//   <root>/MBoxList____
+//   <root>/<title id>/MBoxInfo____
+//   <root>/<title id>/MBoxData.<nnn>
+//   <root>/<title id>/InBox___/BoxInfo_____ and _<message id> files
+//   <root>/<title id>/OutBox__/BoxInfo_____, OBIndex_____ and _<message id> files
+
+#ifdef CECD_HOST
+#define CECD_FAKE_DEFAULT_ROOT "fake_cecd/"
+#else
+#define CECD_FAKE_DEFAULT_ROOT "sdmc:/config/netpass/fake_cecd/"
+#endif
+
+typedef enum {
+	CECD_FAKE_CMD_OPEN_AND_READ = 0,
+	CECD_FAKE_CMD_OPEN_AND_WRITE,
+	CECD_FAKE_CMD_READ_MESSAGE,
+	CECD_FAKE_CMD_WRITE_MESSAGE,
+	CECD_FAKE_CMD_START,
+	CECD_FAKE_CMD_STOP,
+	CECD_FAKE_CMD_GET_STATE,
+	CECD_FAKE_CMD_GET_EVENT,
+	CECD_FAKE_CMD_SPR_GET_SLOTS_METADATA,
+	CECD_FAKE_CMD_SPR_GET_SLOT,
+	CECD_FAKE_CMD_SPR_ADD_SLOT,
+	CECD_FAKE_CMD_SPR_OTHER, // the small SPR state transitions
+	CECD_FAKE_CMD_OTHER,
+	NUM_CECD_FAKE_CMDS,
+} CecdFakeCommand;
+
+// must be called before cecdInit to have an effect
+void cecdFakeSetRoot(const char* root);
+// every call of this command sleeps this long before doing anything, to model the IPC cost
+void cecdFakeSetLatency(CecdFakeCommand cmd, u32 usec);
+// reads name=usec lines, e.g. open_and_read=1500
+void cecdFakeLoadLatencies(const char* path);
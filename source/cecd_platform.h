@@ -0,0 +1,98 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// The few OS services cecd.c and cecd_fake.c need besides the cecd:s IPC itself. On the console
+// these are libctru. Building with CECD_HOST (see host/Makefile) swaps in the POSIX backend in
+// host/cecd_platform_posix.c instead, so that the fake cecd and everything on top of it runs off console
+#ifdef CECD_HOST
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef s32 Result;
+typedef u32 Handle;
+
+#define R_FAILED(res) ((Result)(res) < 0)
+#define R_SUCCEEDED(res) ((Result)(res) >= 0)
+#define MAKERESULT(level, summary, module, description) \
+	((((level) & 0x1F) << 27) | (((summary) & 0x3F) << 21) | (((module) & 0xFF) << 10) | ((description) & 0x3FF))
+#define RL_PERMANENT 27
+#define RS_NOTFOUND 4
+#define RS_INVALIDSTATE 5
+#define RM_APPLICATION 254
+#define RD_NOT_FOUND 1018
+#define RD_NO_DATA 1007
+
+typedef pthread_mutex_t CecdPlatformLock;
+typedef pthread_cond_t CecdPlatformCond;
+// ticks are nanoseconds on the host
+#define CECD_PLATFORM_TICKS_PER_MSEC 1000000ULL
+
+void cecdPlatformLockInit(CecdPlatformLock* lock);
+void cecdPlatformLock(CecdPlatformLock* lock);
+void cecdPlatformUnlock(CecdPlatformLock* lock);
+void cecdPlatformCondInit(CecdPlatformCond* cond);
+void cecdPlatformCondWait(CecdPlatformCond* cond, CecdPlatformLock* lock);
+void cecdPlatformCondBroadcast(CecdPlatformCond* cond);
+u64 cecdPlatformTicks(void);
+void cecdPlatformSleep(u64 ns);
+// one-shot events, the handles stay valid until every duplicate is closed
+Result cecdPlatformEventCreate(Handle* event);
+Result cecdPlatformEventSignal(Handle event);
+Result cecdPlatformEventDuplicate(Handle* out, Handle event);
+Result cecdPlatformEventWait(Handle event, s64 timeout_ns);
+void cecdPlatformEventClose(Handle event);
+// returns the value from before the increment
+static inline s32 cecdPlatformAtomicIncrement(s32* value) { return __atomic_fetch_add(value, 1, __ATOMIC_SEQ_CST); }
+
+#else
+
+#include <3ds.h>
+
+typedef LightLock CecdPlatformLock;
+typedef CondVar CecdPlatformCond;
+#define CECD_PLATFORM_TICKS_PER_MSEC CPU_TICKS_PER_MSEC
+
+static inline void cecdPlatformLockInit(CecdPlatformLock* lock) { LightLock_Init(lock); }
+static inline void cecdPlatformLock(CecdPlatformLock* lock) { LightLock_Lock(lock); }
+static inline void cecdPlatformUnlock(CecdPlatformLock* lock) { LightLock_Unlock(lock); }
+static inline void cecdPlatformCondInit(CecdPlatformCond* cond) { CondVar_Init(cond); }
+static inline void cecdPlatformCondWait(CecdPlatformCond* cond, CecdPlatformLock* lock) { CondVar_Wait(cond, lock); }
+static inline void cecdPlatformCondBroadcast(CecdPlatformCond* cond) { CondVar_Broadcast(cond); }
+static inline u64 cecdPlatformTicks(void) { return svcGetSystemTick(); }
+static inline void cecdPlatformSleep(u64 ns) { svcSleepThread(ns); }
+static inline Result cecdPlatformEventCreate(Handle* event) { return svcCreateEvent(event, RESET_ONESHOT); }
+static inline Result cecdPlatformEventSignal(Handle event) { return svcSignalEvent(event); }
+static inline Result cecdPlatformEventDuplicate(Handle* out, Handle event) { return svcDuplicateHandle(out, event); }
+static inline Result cecdPlatformEventWait(Handle event, s64 timeout_ns) { return svcWaitSynchronization(event, timeout_ns); }
+static inline void cecdPlatformEventClose(Handle event) { svcCloseHandle(event); }
+static inline s32 cecdPlatformAtomicIncrement(s32* value) { return AtomicPostIncrement(value); }
+
+#endif
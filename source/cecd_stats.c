@@ -0,0 +1,153 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cecd_stats.h"
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef CECD_STATS
+static LightLock stats_lock;
+static CecdStatsEntry entries[CECD_STATS_MAX_ENTRIES];
+static int num_entries = 0;
+
+void cecdStatsInit(void) {
+	LightLock_Init(&stats_lock);
+}
+
+void cecdStatsRecord(u32 command, u32 path, u32 bytes, u64 ticks) {
+	u32 us = ticks * 1000 / CPU_TICKS_PER_MSEC;
+	LightLock_Lock(&stats_lock);
+	CecdStatsEntry* e = NULL;
+	for (int i = 0; i < num_entries; i++) {
+		if (entries[i].command == command && entries[i].path == path) {
+			e = &entries[i];
+			break;
+		}
+	}
+	if (!e && num_entries < CECD_STATS_MAX_ENTRIES) {
+		e = &entries[num_entries++];
+		memset(e, 0, sizeof(CecdStatsEntry));
+		e->command = command;
+		e->path = path;
+	}
+	if (e) {
+		e->count++;
+		e->bytes += bytes;
+		e->total_us += us;
+		if (us > e->max_us) e->max_us = us;
+		int bucket = 0;
+		while (bucket < CECD_STATS_BUCKETS - 1 && us >= (64u << bucket)) bucket++;
+		e->buckets[bucket]++;
+	}
+	LightLock_Unlock(&stats_lock);
+}
+
+static int compare_total(const void* a, const void* b) {
+	u64 ta = ((CecdStatsEntry*)a)->total_us;
+	u64 tb = ((CecdStatsEntry*)b)->total_us;
+	return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+int cecdStatsGet(CecdStatsEntry* out, int max) {
+	LightLock_Lock(&stats_lock);
+	int num = num_entries < max ? num_entries : max;
+	memcpy(out, entries, num * sizeof(CecdStatsEntry));
+	LightLock_Unlock(&stats_lock);
+	qsort(out, num, sizeof(CecdStatsEntry), compare_total);
+	return num;
+}
+
+void cecdStatsReset(void) {
+	LightLock_Lock(&stats_lock);
+	num_entries = 0;
+	LightLock_Unlock(&stats_lock);
+}
+#else
+void cecdStatsInit(void) { }
+void cecdStatsRecord(u32 command, u32 path, u32 bytes, u64 ticks) { }
+int cecdStatsGet(CecdStatsEntry* out, int max) {
+	return 0;
+}
+void cecdStatsReset(void) { }
+#endif
+
+u32 cecdStatsPercentileUs(CecdStatsEntry* e, int percent) {
+	if (!e->count) return 0;
+	u32 want = (e->count * percent + 99) / 100;
+	u32 seen = 0;
+	for (int i = 0; i < CECD_STATS_BUCKETS - 1; i++) {
+		seen += e->buckets[i];
+		if (seen >= want) return 64u << i;
+	}
+	return e->max_us;
+}
+
+const char* cecdStatsCommandName(u32 command) {
+	switch (command) {
+		case 0x03: return "ReadMessage";
+		case 0x06: return "WriteMessage";
+		case 0x07: return "WriteMessageWithHMAC";
+		case 0x0A: return "GetSystemInfo";
+		case 0x0B: return "Start";
+		case 0x0C: return "Stop";
+		case 0x0E: return "GetCecdState";
+		case 0x0F: return "GetCecInfoEventHandle";
+		case 0x10: return "GetChangeStateEventHandle";
+		case 0x11: return "OpenAndWrite";
+		case 0x12: return "OpenAndRead";
+		case 0x40A: return "SprCreate";
+		case 0x40B: return "SprInitialise";
+		case 0x40C: return "SprGetSlotsMetadata";
+		case 0x40D: return "SprGetSlot";
+		case 0x40E: return "SprSetTitleSent";
+		case 0x40F: return "SprFinaliseSend";
+		case 0x410: return "SprStartRecv";
+		case 0x411: return "SprAddSlotsMetadata";
+		case 0x412: return "SprAddSlot";
+		case 0x413: return "SprFinaliseRecv";
+		case 0x414: return "SprDone";
+		case 0x415: return "GetBossUserid";
+	}
+	return "?";
+}
+
+void cecdStatsDump(FILE* f) {
+	CecdStatsEntry* list = malloc(sizeof(CecdStatsEntry) * CECD_STATS_MAX_ENTRIES);
+	if (!list) return;
+	int num = cecdStatsGet(list, CECD_STATS_MAX_ENTRIES);
+	fprintf(f, "command path count bytes total_us avg_us p50_us p90_us max_us");
+	for (int i = 0; i < CECD_STATS_BUCKETS; i++) fprintf(f, " <%u", 64u << i);
+	fprintf(f, "\n");
+	for (int i = 0; i < num; i++) {
+		CecdStatsEntry* e = &list[i];
+		fprintf(f, "%s(0x%X) %d %lu %llu %llu %llu %lu %lu %lu",
+			cecdStatsCommandName(e->command), e->command, e->path, e->count, e->bytes, e->total_us,
+			e->total_us / e->count, cecdStatsPercentileUs(e, 50), cecdStatsPercentileUs(e, 90), e->max_us);
+		for (int j = 0; j < CECD_STATS_BUCKETS; j++) fprintf(f, " %lu", e->buckets[j]);
+		fprintf(f, "\n");
+	}
+	free(list);
+}
+
+Result cecdStatsDumpToFile(void) {
+	FILE* f = fopen(CECD_STATS_DUMP_PATH, "w");
+	if (!f) return -1;
+	cecdStatsDump(f);
+	fclose(f);
+	return 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+#include <stdio.h>
+
+// Only recorded when building with CECD_STATS=1, the functions are no-ops otherwise
+
+#define CECD_STATS_MAX_ENTRIES 48
+// bucket i counts calls taking less than 64us << i, the last one everything slower
+#define CECD_STATS_BUCKETS 12
+#define CECD_STATS_DUMP_PATH "sdmc:/config/netpass/cecd_stats.txt"
+
+typedef struct {
+	u16 command; // the IPC command id
+	u16 path; // path type, or whether it's the outbox for messages
+	u32 count;
+	u64 bytes;
+	u64 total_us;
+	u32 max_us;
+	u32 buckets[CECD_STATS_BUCKETS];
+} CecdStatsEntry;
+
+// cecdInit calls this, before any other thread can make IPC calls
+void cecdStatsInit(void);
+void cecdStatsRecord(u32 command, u32 path, u32 bytes, u64 ticks);
+// copies out up to max entries, sorted by total time spent, returns how many
+int cecdStatsGet(CecdStatsEntry* entries, int max);
+void cecdStatsReset(void);
+void cecdStatsDump(FILE* f);
+Result cecdStatsDumpToFile(void);
+// the latency below which the given fraction (in percent) of calls finished, from the histogram
+u32 cecdStatsPercentileUs(CecdStatsEntry* e, int percent);
+const char* cecdStatsCommandName(u32 command);
@@ -0,0 +1,176 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "cecd_worker.h"
+#include "cecd.h"
+#include "api.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+static LightLock queue_lock;
+static CondVar queue_cond;
+static CecdJob* queue_head = NULL;
+static CecdJob* queue_tail = NULL;
+static Thread worker_thread = NULL;
+static bool worker_running = false;
+static LightLock exchange_lock;
+
+static void run_job(CecdJob* job) {
+	if (job->func) {
+		job->res = job->func(job->arg);
+	} else {
+		job->res = cecdOpenAndRead(job->program_id, job->path_type, job->size, job->buf);
+	}
+}
+
+static void free_job(CecdJob* job) {
+	if (job->buf) free(job->buf);
+	free(job);
+}
+
+static void worker(void* p) {
+	LightLock_Lock(&queue_lock);
+	// we drain the queue before quitting, somebody may be waiting on a job
+	while (worker_running || queue_head) {
+		if (!queue_head) {
+			CondVar_Wait(&queue_cond, &queue_lock);
+			continue;
+		}
+		CecdJob* job = queue_head;
+		queue_head = job->next;
+		if (!queue_head) queue_tail = NULL;
+		if (job->released) {
+			// nobody is interested in the result anymore
+			free_job(job);
+			continue;
+		}
+		LightLock_Unlock(&queue_lock);
+
+		run_job(job);
+
+		LightLock_Lock(&queue_lock);
+		job->done = true;
+		if (job->released) {
+			free_job(job);
+		} else {
+			CondVar_Broadcast(&queue_cond);
+		}
+	}
+	LightLock_Unlock(&queue_lock);
+}
+
+void cecdWorkerInit(void) {
+	LightLock_Init(&queue_lock);
+	CondVar_Init(&queue_cond);
+	LightLock_Init(&exchange_lock);
+	worker_running = true;
+	worker_thread = threadCreate(worker, NULL, 8*1024, main_thread_prio()+1, -2, false);
+	if (!worker_thread) {
+		DEBUG_PRINTF("Failed to start the cecd worker, running cecd access inline\n");
+		worker_running = false;
+	}
+}
+
+void cecdWorkerExit(void) {
+	if (!worker_thread) return;
+	LightLock_Lock(&queue_lock);
+	worker_running = false;
+	CondVar_Broadcast(&queue_cond);
+	LightLock_Unlock(&queue_lock);
+	threadJoin(worker_thread, U64_MAX);
+	threadFree(worker_thread);
+	worker_thread = NULL;
+}
+
+static void submit(CecdJob* job) {
+	LightLock_Lock(&queue_lock);
+	if (!worker_running) {
+		LightLock_Unlock(&queue_lock);
+		run_job(job);
+		job->done = true;
+		return;
+	}
+	if (queue_tail) {
+		queue_tail->next = job;
+	} else {
+		queue_head = job;
+	}
+	queue_tail = job;
+	CondVar_Broadcast(&queue_cond);
+	LightLock_Unlock(&queue_lock);
+}
+
+CecdJob* cecdQueueOpenAndRead(u32 program_id, u32 path_type, u32 size) {
+	CecdJob* job = malloc(sizeof(CecdJob));
+	if (!job) return NULL;
+	memset(job, 0, sizeof(CecdJob));
+	// two extra zero bytes so that utf16 strings we read are always terminated
+	job->buf = malloc(size + 2);
+	if (!job->buf) {
+		free(job);
+		return NULL;
+	}
+	memset(job->buf, 0, size + 2);
+	job->program_id = program_id;
+	job->path_type = path_type;
+	job->size = size;
+	submit(job);
+	return job;
+}
+
+Result cecdWorkerRun(CecdJobFunc func, void* arg) {
+	if (worker_thread && threadGetCurrent() == worker_thread) return func(arg);
+	CecdJob job;
+	memset(&job, 0, sizeof(CecdJob));
+	job.func = func;
+	job.arg = arg;
+	submit(&job);
+	return cecdJobWait(&job);
+}
+
+Result cecdExchangeLocked(CecdJobFunc func, void* arg) {
+	LightLock_Lock(&exchange_lock);
+	Result res = func(arg);
+	LightLock_Unlock(&exchange_lock);
+	return res;
+}
+
+bool cecdJobDone(CecdJob* job) {
+	LightLock_Lock(&queue_lock);
+	bool done = job->done;
+	LightLock_Unlock(&queue_lock);
+	return done;
+}
+
+Result cecdJobWait(CecdJob* job) {
+	LightLock_Lock(&queue_lock);
+	while (!job->done) CondVar_Wait(&queue_cond, &queue_lock);
+	LightLock_Unlock(&queue_lock);
+	return job->res;
+}
+
+void cecdJobRelease(CecdJob* job) {
+	if (!job) return;
+	LightLock_Lock(&queue_lock);
+	bool done = job->done;
+	job->released = true;
+	LightLock_Unlock(&queue_lock);
+	if (done) free_job(job);
+}
@@ -0,0 +1,58 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <3ds.h>
+
+// all short cecd access goes through one worker thread, so that the UI never blocks on IPC
+// and so that it all happens one after the other. Exchanges wait on the network and on cecd state
+// changes, so they don't go through the worker: they run on their caller's thread under the
+// exchange lock, one at a time. The SPR lock in cecd.c keeps their box access apart from the worker's
+
+typedef Result (*CecdJobFunc)(void* arg);
+
+typedef struct CecdJob CecdJob;
+struct CecdJob {
+	CecdJobFunc func; // NULL for plain reads
+	void* arg;
+	u32 program_id;
+	u32 path_type;
+	u32 size;
+	u8* buf; // owned by the job
+	Result res;
+	bool done;
+	bool released;
+	CecdJob* next;
+};
+
+void cecdWorkerInit(void);
+void cecdWorkerExit(void);
+// queues a cecdOpenAndRead, job->buf (zero terminated) and job->res are valid once cecdJobDone() returns true
+CecdJob* cecdQueueOpenAndRead(u32 program_id, u32 path_type, u32 size);
+// runs func on the worker and waits for it. Calls from the worker itself run right away
+Result cecdWorkerRun(CecdJobFunc func, void* arg);
+// runs an exchange, or anything else that talks to the server while it has cecd, right here on
+// the calling thread once no other exchange is running. This never touches the worker, so it
+// blocks the caller for the whole exchange and must not be called from the UI or the worker
+Result cecdExchangeLocked(CecdJobFunc func, void* arg);
+bool cecdJobDone(CecdJob* job);
+Result cecdJobWait(CecdJob* job);
+// frees the job, or has the worker free it if it is still queued
+void cecdJobRelease(CecdJob* job);
@@ -30,6 +30,7 @@
 #include <dirent.h>
 #include <unistd.h>
 #include "boss.h"
+#include "report_index.h"
 
 #define PATCHES_COPY_DSTDIR "sdmc:/luma/sysmodules/"
 #define PATCHES_COPY_SRCDIR "romfs:/patches/"
@@ -48,6 +49,8 @@ Config config = {
 	.welcome_version = 0,
 	.patches_version = 0,
 	.bg_music = 1,
+	.log_budget_entries = 1000,
+	.log_budget_mb = 64,
 };
 
 void addIgnoredTitle(u32 title_id) {
@@ -138,34 +141,42 @@ void load(void) {
 		if (strcmp(key, "BG_MUSIC") == 0) {
 			config.bg_music = strcmp(value, "TRUE") == 0;
 		}
+		if (strcmp(key, "LOG_BUDGET_ENTRIES") == 0) {
+			int budget = atoi(value);
+			// the index can't hold more than that anyways
+			if (budget > REPORT_INDEX_MAX_ENTRIES) budget = REPORT_INDEX_MAX_ENTRIES;
+			if (budget > 0) config.log_budget_entries = budget;
+		}
+		if (strcmp(key, "LOG_BUDGET_MB") == 0) {
+			int budget = atoi(value);
+			if (budget > 0) config.log_budget_mb = budget;
+		}
 		if (strcmp(key, "TITLE_IDS_IGNORED") == 0) {
-			// Open mbox_list now to avoid repeatedly doing it later
-			Result res = 0;
-			CecMboxListHeader mbox_list;
-			res = cecdOpenAndRead(0, CEC_PATH_MBOX_LIST, sizeof(CecMboxListHeader), (u8*)&mbox_list);
-			if (R_FAILED(res)) continue;
-			
-			// Read titles ids
+			// Read titles ids, configPruneIgnoredTitles() drops stale ones once the mbox list is loaded
 			for (size_t i = 0; i < 24; i++) {
 				sscanf(&value[9*i], "%lx,", &config.title_ids_ignored[i]);
-				
-				// Remove title id if not in mbox_list
-				if (config.title_ids_ignored[i] == 0) continue;
-				bool found = false;
-				for (size_t j = 0; j < mbox_list.num_boxes; j++) {
-					u32 title_id = strtol((const char*)mbox_list.box_names[j], NULL, 16);
-					if (title_id == config.title_ids_ignored[i]) {
-						found = true;
-						break;
-					}
-				}
-				if (!found) config.title_ids_ignored[i] = 0;
 			}
 		}
 	}
 	fclose(f);
 }
 
+void configPruneIgnoredTitles(CecMboxListHeader* mbox_list) {
+	for (size_t i = 0; i < 24; i++) {
+		// Remove title id if not in mbox_list
+		if (config.title_ids_ignored[i] == 0) continue;
+		bool found = false;
+		for (size_t j = 0; j < mbox_list->num_boxes; j++) {
+			u32 title_id = strtol((const char*)mbox_list->box_names[j], NULL, 16);
+			if (title_id == config.title_ids_ignored[i]) {
+				found = true;
+				break;
+			}
+		}
+		if (!found) config.title_ids_ignored[i] = 0;
+	}
+}
+
 void configWrite(void) {
 	FILE* f = fopen(config_path, "w");
 	if (!f) {
@@ -190,6 +201,10 @@ void configWrite(void) {
 	fputs_blk(line, f);
 	snprintf(line, 250, "bg_music=%s\n", config.bg_music ? "true" : "false");
 	fputs_blk(line, f);
+	snprintf(line, 250, "log_budget_entries=%ld\n", config.log_budget_entries);
+	fputs_blk(line, f);
+	snprintf(line, 250, "log_budget_mb=%ld\n", config.log_budget_mb);
+	fputs_blk(line, f);
 	if (config.language == -1) {
 		fputs_blk("language=system\n", f);
 	} else {
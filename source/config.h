@@ -19,6 +19,7 @@
 #pragma once
 
 #include <3ds.h>
+#include "cecd.h"
 
 typedef struct {
 	int last_location;
@@ -31,6 +32,9 @@ typedef struct {
 	int welcome_version;
 	u32 title_ids_ignored[24];
 	bool bg_music;
+	// how much the log of received passes may grow before old ones are deleted
+	u32 log_budget_entries;
+	u32 log_budget_mb;
 } Config;
 
 void addIgnoredTitle(u32 title_id);
@@ -38,6 +42,8 @@ void removeIgnoredTitle(u32 title_id);
 bool isTitleIgnored(u32 title_id);
 
 void configInit(void);
+// forget about ignored titles which no longer have a box
+void configPruneIgnoredTitles(CecMboxListHeader* mbox_list);
 void configWrite(void);
 
 bool clearPatches(void);
@@ -0,0 +1,93 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "connectivity.h"
+#include "debug.h"
+#include <stdio.h>
+
+void connectivityMonitorInit(ConnectivityMonitor* m) {
+	m->state = LINK_UNKNOWN;
+	m->down_samples = 0;
+}
+
+ConnectivityEvent connectivityFeed(ConnectivityMonitor* m, bool link_up) {
+	if (link_up) {
+		m->down_samples = 0;
+		if (m->state == LINK_UP) return CONNECTIVITY_EVENT_NONE;
+		m->state = LINK_UP;
+		return CONNECTIVITY_EVENT_ONLINE;
+	}
+	if (m->state == LINK_DOWN) return CONNECTIVITY_EVENT_NONE;
+	if (m->state == LINK_UP && ++m->down_samples < CONNECTIVITY_DOWN_SAMPLES) return CONNECTIVITY_EVENT_NONE;
+	bool was_up = m->state == LINK_UP;
+	m->state = LINK_DOWN;
+	m->down_samples = 0;
+	return was_up ? CONNECTIVITY_EVENT_OFFLINE : CONNECTIVITY_EVENT_NONE;
+}
+
+static ConnectivityMonitor monitor;
+static bool ac_inited = false;
+
+static bool default_probe(void) {
+#ifndef CECD_HOST
+	u32 status = 0;
+	if (ac_inited && R_SUCCEEDED(ACU_GetWifiStatus(&status))) return status != 0;
+#endif
+	// if we can't ask AC, assume we are online and let the requests find out
+	return true;
+}
+
+static ConnectivityProbe probe = default_probe;
+
+void connectivityInit(void) {
+	connectivityMonitorInit(&monitor);
+#ifndef CECD_HOST
+	ac_inited = R_SUCCEEDED(acInit());
+#endif
+}
+
+void connectivityExit(void) {
+#ifndef CECD_HOST
+	if (ac_inited) acExit();
+#endif
+	ac_inited = false;
+}
+
+void connectivitySetProbe(ConnectivityProbe p) {
+	probe = p ? p : default_probe;
+}
+
+ConnectivityEvent connectivityPoll(void) {
+	ConnectivityEvent event = connectivityFeed(&monitor, probe());
+	if (event == CONNECTIVITY_EVENT_ONLINE) DEBUG_PRINTF("Link up\n");
+	if (event == CONNECTIVITY_EVENT_OFFLINE) DEBUG_PRINTF("Link down\n");
+	return event;
+}
+
+bool connectivityIsOnline(void) {
+	return monitor.state == LINK_UP;
+}
+
+bool connectivityWaitOnline(u32 timeout_ms) {
+	for (u32 waited = 0; ; waited += CONNECTIVITY_POLL_MS) {
+		connectivityPoll();
+		if (connectivityIsOnline()) return true;
+		if (waited >= timeout_ms) return false;
+		cecdPlatformSleep((u64)1000000 * CONNECTIVITY_POLL_MS);
+	}
+}
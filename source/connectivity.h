@@ -0,0 +1,61 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// AC on the console, the host build (see host/Makefile) only has whatever probe gets plugged in
+#include "cecd_platform.h"
+
+typedef enum {
+	LINK_UNKNOWN = 0,
+	LINK_DOWN,
+	LINK_UP,
+} LinkState;
+
+typedef enum {
+	CONNECTIVITY_EVENT_NONE = 0,
+	CONNECTIVITY_EVENT_ONLINE,
+	CONNECTIVITY_EVENT_OFFLINE,
+} ConnectivityEvent;
+
+typedef struct {
+	LinkState state;
+	int down_samples; // consecutive down samples while we still consider ourselves up
+} ConnectivityMonitor;
+
+// a single link down sample while up is ignored, as the AC state flickers while roaming
+#define CONNECTIVITY_DOWN_SAMPLES 2
+// how often connectivityWaitOnline samples the link
+#define CONNECTIVITY_POLL_MS 100
+
+// returns whether the link is currently up
+typedef bool (*ConnectivityProbe)(void);
+
+// pure state machine, feed it link samples and it tells you about the edges
+void connectivityMonitorInit(ConnectivityMonitor* m);
+ConnectivityEvent connectivityFeed(ConnectivityMonitor* m, bool link_up);
+
+void connectivityInit(void);
+void connectivityExit(void);
+// replace the link probe, e.g. with a scripted sequence. NULL restores the default one
+void connectivitySetProbe(ConnectivityProbe probe);
+// sample the probe once and feed it to the global monitor
+ConnectivityEvent connectivityPoll(void);
+bool connectivityIsOnline(void);
+// poll until the link is up, returns false on timeout
+bool connectivityWaitOnline(u32 timeout_ms);
@@ -51,6 +51,7 @@ struct CurlHandle {
 	char* url;
 	char* title_name;
 	char* hmac_key;
+	u64 idempotency_key;
 	int size;
 	u8* body;
 	Result res;
@@ -59,6 +60,8 @@ struct CurlHandle {
 };
 
 static struct CurlHandle handles[MAX_CONNECTIONS] = {0};
+// requests can come in from several threads at once, e.g. the startup tasks
+static LightLock handles_lock;
 
 Result getMac(u8 mac[6]) {
 	Result res = 0;
@@ -115,10 +118,29 @@ void curlFreeHandler(int offset) {
 	handles[offset].status = CURL_HANDLE_STATUS_RESET;
 }
 
-Result httpRequest(char* method, char* url, int size, u8* body, CurlReply** reply, char* title_name, char* hmac_key) {
+bool httpIsNetworkError(Result res) {
+	if (R_SUCCEEDED(res)) return false;
+	switch (-res) {
+		case 1: // no free handle
+		case CURLE_COULDNT_RESOLVE_PROXY:
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+		case CURLE_OPERATION_TIMEDOUT:
+		case CURLE_SSL_CONNECT_ERROR:
+		case CURLE_GOT_NOTHING:
+		case CURLE_SEND_ERROR:
+		case CURLE_RECV_ERROR:
+			return true;
+	}
+	// the server had a hiccup, worth trying again later
+	return -res >= 500 && -res < 600;
+}
+
+static Result http_request(char* method, char* url, int size, u8* body, CurlReply** reply, char* title_name, char* hmac_key, u64 idempotency_key) {
 	Result res = 0;
 	int curl_handle_slot = 0;
 	bool found_handle_slot = false;
+	LightLock_Lock(&handles_lock);
 	for (; curl_handle_slot < MAX_CONNECTIONS; curl_handle_slot++) {
 		if (handles[curl_handle_slot].status == CURL_HANDLE_STATUS_FREE) {
 			handles[curl_handle_slot].status = CURL_HANDLE_STATUS_RESERVED;
@@ -126,6 +148,7 @@ Result httpRequest(char* method, char* url, int size, u8* body, CurlReply** repl
 			break;
 		}
 	}
+	LightLock_Unlock(&handles_lock);
 	if (!found_handle_slot) {
 		// TODO: dunno, wait or something?
 		return -1;
@@ -148,6 +171,7 @@ Result httpRequest(char* method, char* url, int size, u8* body, CurlReply** repl
 	handles[curl_handle_slot].body = body;
 	handles[curl_handle_slot].title_name = title_name;
 	handles[curl_handle_slot].hmac_key = hmac_key;
+	handles[curl_handle_slot].idempotency_key = idempotency_key;
 	if (handles[curl_handle_slot].file_reply) {
 		handles[curl_handle_slot].title_name = 0;
 		handles[curl_handle_slot].hmac_key = 0;
@@ -170,6 +194,14 @@ Result httpRequest(char* method, char* url, int size, u8* body, CurlReply** repl
 	return res;
 }
 
+Result httpRequest(char* method, char* url, int size, u8* body, CurlReply** reply, char* title_name, char* hmac_key) {
+	return http_request(method, url, size, body, reply, title_name, hmac_key, 0);
+}
+
+Result httpRequestIdempotent(char* method, char* url, int size, u8* body, u64 idempotency_key) {
+	return http_request(method, url, size, body, 0, 0, 0, idempotency_key);
+}
+
 static CURLM* curl_multi_handle;
 
 void curl_multi_loop_request_finish(int i) {
@@ -285,6 +317,12 @@ void curl_multi_loop_request_setup(int i) {
 		headers = curl_slist_append(headers, header_hmac_key);
 	}
 
+	if (h->idempotency_key) {
+		char header_idempotency_key[40];
+		snprintf(header_idempotency_key, sizeof(header_idempotency_key), "Idempotency-Key: %016llX", h->idempotency_key);
+		headers = curl_slist_append(headers, header_idempotency_key);
+	}
+
 	if (h->body) {
 		curl_easy_setopt(h->handle, CURLOPT_POSTFIELDS, h->body);
 		headers = curl_slist_append(headers, "Content-Type: application/binary");
@@ -373,6 +411,7 @@ void curl_multi_loop(void* p) {
 
 Result curlInit(void) {
 	Result res;
+	LightLock_Init(&handles_lock);
 	// ok, we have to init this first
 	SOC_buffer = (u32*)memalign(SOC_ALIGN, SOC_BUFFERSIZE);
 	if (!SOC_buffer) return -1;
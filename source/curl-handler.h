@@ -34,5 +34,9 @@ Result curlInit(void);
 void curlExit(void);
 void curlFreeHandler(int offset);
 Result httpRequest(char* method, char* url, int size, u8* body, CurlReply** reply, char* title_name, char* hmac_key);
+// same as httpRequest, but the server can drop replays carrying the same key
+Result httpRequestIdempotent(char* method, char* url, int size, u8* body, u64 idempotency_key);
+// whether a failed request is worth retrying later, i.e. we are offline or the server is struggling
+bool httpIsNetworkError(Result res);
 u8* getMacBuf(void);
 void getMacStr(char value[13]);
@@ -0,0 +1,129 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "exchange_stats.h"
+#include "utils.h"
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#define EXCHANGE_STATS_PATH "sdmc:/config/netpass/exchange_stats.bin"
+
+static ExchangeStatsEntry cur_entry;
+static u64 cur_start = 0;
+static bool in_exchange = false;
+
+u64 exchangeStatsNow(void) {
+	return svcGetSystemTick();
+}
+
+static u32 ticks_to_ms(u64 ticks) {
+	return (u32)(ticks / CPU_TICKS_PER_MSEC);
+}
+
+static void add_timing(ExchangeStageTiming* t, u32 ms) {
+	if (!t->count || ms < t->min_ms) t->min_ms = ms;
+	if (ms > t->max_ms) t->max_ms = ms;
+	t->total_ms += ms;
+	t->count++;
+}
+
+static void merge_timing(ExchangeStageTiming* t, ExchangeStageTiming* other) {
+	if (!other->count) return;
+	if (!t->count || other->min_ms < t->min_ms) t->min_ms = other->min_ms;
+	if (other->max_ms > t->max_ms) t->max_ms = other->max_ms;
+	t->total_ms += other->total_ms;
+	t->count += other->count;
+}
+
+void exchangeStatsBegin(void) {
+	memset(&cur_entry, 0, sizeof(ExchangeStatsEntry));
+	cur_entry.started = time(NULL);
+	cur_start = exchangeStatsNow();
+	in_exchange = true;
+}
+
+void exchangeStatsRecord(ExchangeStage stage, u64 start) {
+	if (!in_exchange || stage >= NUM_EXCHANGE_STAGES) return;
+	add_timing(&cur_entry.stages[stage], ticks_to_ms(exchangeStatsNow() - start));
+}
+
+static FILE* open_stats_file(ExchangeStatsHeader* header) {
+	FILE* f = fopen(EXCHANGE_STATS_PATH, "r+b");
+	if (f) {
+		if (fread_blk(header, sizeof(ExchangeStatsHeader), 1, f) == 1
+			&& header->magic == 0x5358504E && header->version == 1
+			&& header->max_size == EXCHANGE_STATS_MAX_ENTRIES) {
+			return f;
+		}
+		// stale or corrupted file, start over
+		fclose(f);
+	}
+	f = fopen(EXCHANGE_STATS_PATH, "w+b");
+	if (!f) return NULL;
+	header->magic = 0x5358504E;
+	header->version = 1;
+	header->max_size = EXCHANGE_STATS_MAX_ENTRIES;
+	header->cur_size = 0;
+	header->next = 0;
+	return f;
+}
+
+void exchangeStatsEnd(Result res) {
+	if (!in_exchange) return;
+	in_exchange = false;
+	cur_entry.result = res;
+	cur_entry.total_ms = ticks_to_ms(exchangeStatsNow() - cur_start);
+
+	ExchangeStatsHeader header;
+	FILE* f = open_stats_file(&header);
+	if (!f) return;
+	// only the slot we replace and the header are written, the rest of the ring stays untouched
+	fseek(f, sizeof(ExchangeStatsHeader) + header.next * sizeof(ExchangeStatsEntry), SEEK_SET);
+	fwrite_blk(&cur_entry, sizeof(ExchangeStatsEntry), 1, f);
+	header.next = (header.next + 1) % header.max_size;
+	if (header.cur_size < header.max_size) header.cur_size++;
+	fseek(f, 0, SEEK_SET);
+	fwrite_blk(&header, sizeof(ExchangeStatsHeader), 1, f);
+	fclose(f);
+}
+
+bool exchangeStatsLoadSummary(ExchangeStatsSummary* summary) {
+	memset(summary, 0, sizeof(ExchangeStatsSummary));
+	FILE* f = fopen(EXCHANGE_STATS_PATH, "rb");
+	if (!f) return false;
+	ExchangeStatsHeader header;
+	if (fread_blk(&header, sizeof(ExchangeStatsHeader), 1, f) != 1
+		|| header.magic != 0x5358504E || header.version != 1
+		|| header.cur_size > EXCHANGE_STATS_MAX_ENTRIES) {
+		fclose(f);
+		return false;
+	}
+	ExchangeStatsEntry entry;
+	for (int i = 0; i < header.cur_size; i++) {
+		if (fread_blk(&entry, sizeof(ExchangeStatsEntry), 1, f) != 1) break;
+		summary->num_exchanges++;
+		if (R_FAILED(entry.result)) summary->num_failed++;
+		add_timing(&summary->total, entry.total_ms);
+		for (int j = 0; j < NUM_EXCHANGE_STAGES; j++) {
+			merge_timing(&summary->stages[j], &entry.stages[j]);
+		}
+	}
+	fclose(f);
+	return true;
+}
@@ -0,0 +1,71 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+
+#define EXCHANGE_STATS_MAX_ENTRIES 32
+
+typedef enum {
+	EXCHANGE_STAGE_MBOX_LIST = 0,
+	EXCHANGE_STAGE_METADATA,
+	EXCHANGE_STAGE_SPR_ENTER,
+	EXCHANGE_STAGE_UPLOAD,
+	EXCHANGE_STAGE_FINALISE_SEND,
+	EXCHANGE_STAGE_DOWNLOAD,
+	EXCHANGE_STAGE_ADD_SLOTS,
+	EXCHANGE_STAGE_LOG_WRITE,
+	EXCHANGE_STAGE_SPR_EXIT,
+	NUM_EXCHANGE_STAGES,
+} ExchangeStage;
+
+typedef struct {
+	u32 total_ms;
+	u32 min_ms;
+	u32 max_ms;
+	u32 count;
+} ExchangeStageTiming;
+
+typedef struct {
+	u64 started; // unix time
+	Result result;
+	u32 total_ms;
+	ExchangeStageTiming stages[NUM_EXCHANGE_STAGES];
+} ExchangeStatsEntry;
+
+typedef struct {
+	u32 magic; // 0x5358504E "NPXS"
+	int version; // 1
+	u32 max_size;
+	u32 cur_size;
+	u32 next;
+} ExchangeStatsHeader;
+
+typedef struct {
+	int num_exchanges;
+	int num_failed;
+	ExchangeStageTiming total;
+	ExchangeStageTiming stages[NUM_EXCHANGE_STAGES];
+} ExchangeStatsSummary;
+
+u64 exchangeStatsNow(void);
+void exchangeStatsBegin(void);
+void exchangeStatsRecord(ExchangeStage stage, u64 start);
+void exchangeStatsEnd(Result res);
+bool exchangeStatsLoadSummary(ExchangeStatsSummary* summary);
@@ -19,6 +19,7 @@
 #include "integration.h"
 #include "api.h"
 #include "utils.h"
+#include "pending.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -76,15 +77,26 @@ Result toggle_integration(u32 id) {
 		res = -1;
 		return res;
 	}
-	char url[80];
-	snprintf(url, 80, "%s/integration/%ld", BASE_URL, id);
-	char* method = g_list->entries[index].enabled ? "DELETE" : "PUT";
-	res = httpRequest(method, url, 0, 0, 0, 0, 0);
+	// this is called from the UI, so we only queue it and show the new state right away
+	PendingRecord r;
+	pendingInitRecord(&r, PENDING_INTEGRATION_SET, id);
+	r.flags = !g_list->entries[index].enabled;
+	res = pendingEnqueue(&r);
 	if (R_FAILED(res)) return res;
-	g_list->entries[index].enabled = !g_list->entries[index].enabled;
+	g_list->entries[index].enabled = r.flags;
 	return res;
 }
 
+void integrationRollback(u32 id, bool enabled) {
+	if (!g_list) return;
+	for (int i = 0; i < g_list->header.count; i++) {
+		if (g_list->entries[i].id == id) {
+			g_list->entries[i].enabled = enabled;
+			return;
+		}
+	}
+}
+
 void integrationExit(void) {
 	if (g_list) {
 		free(g_list);
@@ -45,3 +45,5 @@ typedef struct {
 void integrationExit(void);
 IntegrationList* get_integration_list(void);
 Result toggle_integration(u32 id);
+// put an integration back to how it was when the server refused the change
+void integrationRollback(u32 id, bool enabled);
@@ -28,6 +28,17 @@
 #include "report.h"
 #include "music.h"
 #include "integration.h"
+#include "tasks.h"
+#include "pending.h"
+#include "connectivity.h"
+#include "seen.h"
+#include "report_index.h"
+#include "report_pack.h"
+#include "report_prefetch.h"
+#include "report_retention.h"
+#include "report_import.h"
+#include "cecd_worker.h"
+#include "cec_watcher.h"
 
 int main() {
 	osSetSpeedupEnable(true); // enable speedup on N3DS
@@ -55,14 +66,22 @@ int main() {
 	DEBUG_PRINTF("DEBUG ON\n");
 
 	cecdInit();
+	cecdWorkerInit(); // must be after init_main_thread_prio()
 	Result res = curlInit();
 	if (R_FAILED(res)) {
 		DEBUG_PRINTF("Curl initialization failed\n");
 	}
+	connectivityInit();
 	srand(time(NULL));
 
-	configInit(); // must be after cecdInit()
+	configInit();
 	stringsInit(); // must be after configInit()
+	pendingInit(); // must be after configInit()
+	seenInit();
+	reportIndexInit();
+	reportPackInit();
+	titleDataInit();
+	reportPrefetchInit();
 	musicInit(); // must be after romfsInit()
 
 	// mount sharedextdata_b so that we can read it later, for e.g. playcoins
@@ -110,48 +129,82 @@ int main() {
 				}
 		
 				bgLoopInit();
+				cecWatcherInit();
+				reportRetentionInit();
 				if (location == -1) {
 					return getHomeScene(); // load home
 				}
 				return getLocationScene(location);
 			})), lambda(void, (void) {
-				Result res;
-				// first, we import the locally stored passes for reports to work
-				reportInit();
-				// next, we gotta wait for having internet
-                DEBUG_PRINTF("Waiting internet\n");
-				char url[50];
-				snprintf(url, 50, "%s/ping", BASE_URL);
-				int check_count = 0;
-				int max_count = 100;
-				while (true) {
-					res = httpRequest("GET", url, 0, 0, 0, 0, 0);
-					if (R_SUCCEEDED(res)) break;
-					check_count++;
-					if (check_count > max_count) {
-						if (res == -CURLE_COULDNT_RESOLVE_HOST && max_count < 400) {
-							max_count += 100;
-							continue;
+				TaskGraph g;
+				taskGraphInit(&g);
+				// the passes relayed over SPR get imported in the background, that can take a while with a backlog
+				Task* t_log = taskGraphAdd(&g, "log import", lambda(bool, (void) {
+					reportInit();
+					reportImportStart();
+					return true;
+				}), 0);
+				// we gotta wait for having internet
+				Task* t_ping = taskGraphAdd(&g, "ping", lambda(bool, (void) {
+					DEBUG_PRINTF("Waiting internet\n");
+					// no point in pinging before we even have a link. The ping stays even so: right
+					// after connecting DNS keeps failing for a while, which is what the retries are for,
+					// and if the server never answers the user needs that actual error rather than a timeout
+					connectivityWaitOnline(30000);
+					char url[50];
+					snprintf(url, 50, "%s/ping", BASE_URL);
+					int check_count = 0;
+					int max_count = 100;
+					while (true) {
+						Result res = httpRequest("GET", url, 0, 0, 0, 0, 0);
+						if (R_SUCCEEDED(res)) return true;
+						check_count++;
+						if (check_count > max_count) {
+							if (res == -CURLE_COULDNT_RESOLVE_HOST && max_count < 400) {
+								max_count += 100;
+								continue;
+							}
+							location = res;
+							return false;
 						}
-						location = res;
-						return;
 					}
-				}
-				waitForCecdState(true, CEC_COMMAND_STOP, CEC_STATE_ABBREV_IDLE);
-				initTitleData();
-				doSlotExchange();
-				res = getLocation();
-				if (R_FAILED(res) && res != -1) {
-					printf("ERROR failed to get location: %ld\n", res);
-					location = -1;
-				} else {
-					location = res;
-					if (location == -1) {
-						printf("Got location home\n");
+				}), 0);
+				Task* t_cecd = taskGraphAdd(&g, "cecd idle", lambda(bool, (void) {
+					waitForCecdState(true, CEC_COMMAND_STOP, CEC_STATE_ABBREV_IDLE);
+					return true;
+				}), 0);
+				Task* t_titles = taskGraphAdd(&g, "title data", lambda(bool, (void) {
+					cecdWorkerRun(lambda(Result, (void* p) {
+						return initTitleData();
+					}), NULL);
+					return true;
+				}), 1, t_cecd);
+				// the exchange needs the log directory in place, the index lock takes care of the import running alongside
+				taskGraphAdd(&g, "exchange", lambda(bool, (void) {
+					cecdExchangeLocked(lambda(Result, (void* p) {
+						return doSlotExchange();
+					}), NULL);
+					return true;
+				}), 3, t_ping, t_titles, t_log);
+				taskGraphAdd(&g, "location", lambda(bool, (void) {
+					// a location we entered while offline has to reach the server before we ask for it
+					pendingFlush();
+					Result res = getLocation();
+					if (R_FAILED(res) && res != -1) {
+						printf("ERROR failed to get location: %ld\n", res);
+						location = -1;
 					} else {
-						printf("Got location: %d\n", location);
+						location = res;
+						if (location == -1) {
+							printf("Got location home\n");
+						} else {
+							printf("Got location: %d\n", location);
+						}
 					}
-				}
+					return true;
+				}), 1, t_ping);
+				taskGraphRun(&g, 3);
+				taskGraphPrintCriticalPath(&g);
 			}));
 		
 			if (_PATCHES_VERSION_ > config.patches_version) {
@@ -169,6 +222,8 @@ int main() {
 	scene->init(scene);
 
 	while (aptMainLoop()) {
+		applyTitleData();
+		pendingApply();
 		Scene* new_scene = processScene(scene);
 		if (!new_scene) break;
 		if (new_scene != scene) {
@@ -195,6 +250,11 @@ int main() {
 	printf("\nExiting...\n");
 	integrationExit();
 	bgLoopExit();
+	cecWatcherExit();
+	reportRetentionExit();
+	reportImportExit();
+	cecdWorkerExit(); // must be after bgLoopExit() and cecWatcherExit()
+	connectivityExit();
 	musicExit();
 	C2D_Fini();
 	C3D_Fini();
@@ -0,0 +1,339 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pending.h"
+#include "api.h"
+#include "config.h"
+#include "integration.h"
+#include "utils.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PENDING_PATH "sdmc:/config/netpass/pending.bin"
+
+// queue_lock only guards the queue file, send_lock keeps the network requests in order.
+// Nobody holds queue_lock across a request, so queueing from the UI never waits on the network
+static LightLock queue_lock;
+static LightLock send_lock;
+static volatile bool flush_requested = false;
+
+// the server answers on whichever thread sent the record, but config and the play coins belong
+// to the main thread, so what an answer changes locally waits here until pendingApply runs
+typedef struct {
+	u32 type;
+	u32 arg;
+	u32 flags;
+	s32 prev;
+} PendingOutcome;
+static LightLock outcome_lock;
+// a whole flush plus the one record sent right away, the main loop empties this every frame
+static PendingOutcome outcomes[PENDING_MAX_ENTRIES + 1];
+static int num_outcomes = 0;
+
+void pendingInit(void) {
+	LightLock_Init(&queue_lock);
+	LightLock_Init(&send_lock);
+	LightLock_Init(&outcome_lock);
+	mkdir_p("sdmc:/config/netpass/");
+	// anything left over from last time goes out with the first exchange
+	flush_requested = pendingCount() > 0;
+}
+
+void pendingInitRecord(PendingRecord* r, PendingType type, u32 arg) {
+	memset(r, 0, sizeof(PendingRecord));
+	r->type = type;
+	r->arg = arg;
+	r->key = ((u64)rand() << 32) ^ rand() ^ svcGetSystemTick();
+	r->created = time(NULL);
+}
+
+// must hold the lock. Returns the number of records read into *records, which the caller frees
+static int load_queue(PendingRecord** records) {
+	*records = NULL;
+	FILE* f = fopen(PENDING_PATH, "rb");
+	if (!f) return 0;
+	PendingQueueHeader header;
+	if (fread_blk(&header, sizeof(PendingQueueHeader), 1, f) != 1
+		|| header.magic != 0x514D504E || header.version != 1 || header.count > PENDING_MAX_ENTRIES) {
+		fclose(f);
+		return 0;
+	}
+	if (!header.count) {
+		fclose(f);
+		return 0;
+	}
+	*records = malloc(header.count * sizeof(PendingRecord));
+	if (!*records) {
+		fclose(f);
+		return 0;
+	}
+	int count = fread_blk(*records, sizeof(PendingRecord), header.count, f);
+	fclose(f);
+	return count;
+}
+
+// must hold the lock
+static Result write_queue(PendingRecord* records, int count) {
+	if (!count) {
+		unlink(PENDING_PATH);
+		return 0;
+	}
+	FILE* f = fopen(PENDING_PATH, "wb");
+	if (!f) return -1;
+	PendingQueueHeader header = {
+		magic: 0x514D504E,
+		version: 1,
+		count: count,
+	};
+	fwrite_blk(&header, sizeof(PendingQueueHeader), 1, f);
+	fwrite_blk(records, sizeof(PendingRecord), count, f);
+	fclose(f);
+	return 0;
+}
+
+// must hold the lock
+static Result append_queue(PendingRecord* r) {
+	PendingRecord* records = NULL;
+	int count = load_queue(&records);
+	Result res = 0;
+	if (count >= PENDING_MAX_ENTRIES) {
+		printf("ERROR: too many changes waiting to be sent\n");
+		res = -1;
+		goto cleanup;
+	}
+	for (int i = 0; i < count; i++) {
+		if (r->type == PENDING_PASS_PURCHASE && records[i].type == PENDING_PASS_PURCHASE) {
+			// the price depends on the previous purchase going through
+			printf("ERROR: a pass purchase is already waiting to be sent\n");
+			res = -1;
+			goto cleanup;
+		}
+	}
+	PendingRecord* new_records = realloc(records, (count + 1) * sizeof(PendingRecord));
+	if (!new_records) {
+		res = -1;
+		goto cleanup;
+	}
+	records = new_records;
+	memcpy(&records[count], r, sizeof(PendingRecord));
+	res = write_queue(records, count + 1);
+cleanup:
+	if (records) free(records);
+	return res;
+}
+
+static Result send_record(PendingRecord* r) {
+	char url[80];
+	switch (r->type) {
+		case PENDING_LOCATION_ENTER:
+			snprintf(url, 80, "%s/location/%ld/enter", BASE_URL, r->arg);
+			return httpRequestIdempotent("PUT", url, 0, 0, r->key);
+		case PENDING_REPORT:
+			snprintf(url, 80, "%s/report/new", BASE_URL);
+			return httpRequestIdempotent("POST", url, sizeof(ReportSendPayload), (u8*)&r->report, r->key);
+		case PENDING_PASS_PURCHASE:
+			snprintf(url, 80, "%s/pass/title_id/%lx", BASE_URL, r->arg);
+			return httpRequestIdempotent("PUT", url, 0, 0, r->key);
+		case PENDING_INTEGRATION_SET:
+			snprintf(url, 80, "%s/integration/%ld", BASE_URL, r->arg);
+			return httpRequestIdempotent(r->flags ? "PUT" : "DELETE", url, 0, 0, r->key);
+	}
+	return -1;
+}
+
+// main thread only, the back alley reads config.price and the play coins while drawing
+static Result apply_pass_purchase(void) {
+	config.price += 2;
+	configWrite();
+	// the first pass of the day is free
+	if (config.price <= 2) return 0;
+	Handle handle = 0;
+	Result res = FSUSER_OpenFile(&handle, sharedextdata_b, fsMakePath(PATH_ASCII, "/gamecoin.dat"), FS_OPEN_READ | FS_OPEN_WRITE, 0);
+	if (R_FAILED(res)) return res;
+	PlayCoins play_coins;
+	u32 tmpval = 0;
+	res = FSFILE_Read(handle, &tmpval, 0, &play_coins, sizeof(PlayCoins));
+	if (R_FAILED(res)) goto cleanup;
+	play_coins.total_coins -= config.price - 2;
+	res = FSFILE_Write(handle, &tmpval, 0, &play_coins, sizeof(PlayCoins), FS_WRITE_FLUSH);
+cleanup:
+	FSFILE_Close(handle);
+	return res;
+}
+
+static void push_outcome(PendingRecord* r) {
+	LightLock_Lock(&outcome_lock);
+	if (num_outcomes < PENDING_MAX_ENTRIES + 1) {
+		PendingOutcome* o = &outcomes[num_outcomes++];
+		o->type = r->type;
+		o->arg = r->arg;
+		o->flags = r->flags;
+		o->prev = r->prev;
+	} else {
+		printf("ERROR: dropped the local changes of a sent record\n");
+	}
+	LightLock_Unlock(&outcome_lock);
+}
+
+// once the server has answered. Only prints here, the local side effects are up to pendingApply
+static void finish_record(PendingRecord* r, Result res) {
+	switch (r->type) {
+		case PENDING_LOCATION_ENTER:
+			if (R_FAILED(res)) {
+				printf("ERROR: Failed to enter location %ld: %ld\n", r->arg, res);
+				// we showed the location right away, the server says otherwise
+				push_outcome(r);
+			}
+			break;
+		case PENDING_REPORT:
+			if (R_FAILED(res)) {
+				printf("Error sending report: %ld\n", res);
+			} else {
+				printf("report sent\n");
+			}
+			break;
+		case PENDING_PASS_PURCHASE:
+			if (res == -404) {
+				printf("ERROR: No fitting pass found!\n");
+			} else if (R_FAILED(res)) {
+				printf("ERROR: failed processing pass: %lx\n", res);
+			} else {
+				push_outcome(r);
+			}
+			break;
+		case PENDING_INTEGRATION_SET:
+			if (R_FAILED(res)) {
+				printf("ERROR: Failed to update integration %ld: %ld\n", r->arg, res);
+				push_outcome(r);
+			}
+			break;
+	}
+}
+
+void pendingApply(void) {
+	PendingOutcome applying[PENDING_MAX_ENTRIES + 1];
+	LightLock_Lock(&outcome_lock);
+	int count = num_outcomes;
+	if (count) memcpy(applying, outcomes, count * sizeof(PendingOutcome));
+	num_outcomes = 0;
+	LightLock_Unlock(&outcome_lock);
+	for (int i = 0; i < count; i++) {
+		PendingOutcome* o = &applying[i];
+		switch (o->type) {
+			case PENDING_LOCATION_ENTER:
+				if (config.last_location == o->arg) {
+					config.last_location = o->prev;
+					configWrite();
+				}
+				break;
+			case PENDING_PASS_PURCHASE: {
+				Result res = apply_pass_purchase();
+				if (R_FAILED(res)) {
+					_e(res);
+					printf("ERROR: failed processing pass: %lx\n", res);
+				}
+				break;
+			}
+			case PENDING_INTEGRATION_SET:
+				integrationRollback(o->arg, !o->flags);
+				break;
+		}
+	}
+}
+
+Result pendingSubmit(PendingRecord* r) {
+	Result res;
+	LightLock_Lock(&send_lock);
+	LightLock_Lock(&queue_lock);
+	PendingRecord* records = NULL;
+	int count = load_queue(&records);
+	if (records) free(records);
+	LightLock_Unlock(&queue_lock);
+	if (count == 0) {
+		res = send_record(r);
+		if (!httpIsNetworkError(res)) {
+			finish_record(r, res);
+			goto cleanup;
+		}
+	}
+	res = pendingEnqueue(r);
+cleanup:
+	LightLock_Unlock(&send_lock);
+	return res;
+}
+
+Result pendingEnqueue(PendingRecord* r) {
+	LightLock_Lock(&queue_lock);
+	Result res = append_queue(r);
+	if (R_SUCCEEDED(res)) {
+		res = PENDING_QUEUED;
+		flush_requested = true;
+	}
+	LightLock_Unlock(&queue_lock);
+	return res;
+}
+
+Result pendingFlush(void) {
+	Result res = 0;
+	LightLock_Lock(&send_lock);
+	flush_requested = false;
+	// send from a copy, the UI may queue more while we are waiting on the server
+	LightLock_Lock(&queue_lock);
+	PendingRecord* records = NULL;
+	int count = load_queue(&records);
+	LightLock_Unlock(&queue_lock);
+	if (!count) goto cleanup;
+	DEBUG_PRINTF("Sending %d queued changes\n", count);
+	int sent = 0;
+	for (; sent < count; sent++) {
+		res = send_record(&records[sent]);
+		if (httpIsNetworkError(res)) break;
+		finish_record(&records[sent], res);
+	}
+	if (sent == count) res = 0;
+	free(records);
+	records = NULL;
+	// only we remove records and we hold send_lock, so what we sent is still at the front
+	LightLock_Lock(&queue_lock);
+	int cur_count = load_queue(&records);
+	int drop = sent < cur_count ? sent : cur_count;
+	if (drop) memmove(records, records + drop, (cur_count - drop) * sizeof(PendingRecord));
+	write_queue(records, cur_count - drop);
+	LightLock_Unlock(&queue_lock);
+cleanup:
+	if (records) free(records);
+	LightLock_Unlock(&send_lock);
+	return res;
+}
+
+bool pendingFlushRequested(void) {
+	return flush_requested;
+}
+
+int pendingCount(void) {
+	LightLock_Lock(&queue_lock);
+	PendingRecord* records = NULL;
+	int count = load_queue(&records);
+	if (records) free(records);
+	LightLock_Unlock(&queue_lock);
+	return count;
+}
@@ -0,0 +1,62 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+#include "report.h"
+
+#define PENDING_MAX_ENTRIES 64
+// returned by pendingSubmit if the mutation couldn't be sent right away and was queued instead
+#define PENDING_QUEUED 1
+
+typedef enum {
+	PENDING_LOCATION_ENTER = 1,
+	PENDING_REPORT,
+	PENDING_PASS_PURCHASE,
+	PENDING_INTEGRATION_SET,
+} PendingType;
+
+typedef struct {
+	u32 type;
+	u32 arg; // location, title id or integration id
+	u32 flags; // for integrations, whether to enable it
+	s32 prev; // for locations, the one we were in before, to go back to if the server refuses
+	u64 key; // idempotency key, stays the same across replays
+	u64 created; // unix time
+	ReportSendPayload report;
+} PendingRecord;
+
+typedef struct {
+	u32 magic; // 0x514D504E "NPMQ"
+	int version; // 1
+	u32 count;
+} PendingQueueHeader;
+
+void pendingInit(void);
+void pendingInitRecord(PendingRecord* r, PendingType type, u32 arg);
+// send the mutation right away if nothing is queued before it, else (or if we are offline) queue it
+Result pendingSubmit(PendingRecord* r);
+// only queue the mutation and have the background loop send it, for callers that must not block
+Result pendingEnqueue(PendingRecord* r);
+// send all queued mutations in order, stopping at the first one that can't reach the server
+Result pendingFlush(void);
+bool pendingFlushRequested(void);
+// apply what the server's answers change locally, from the main thread only
+void pendingApply(void);
+int pendingCount(void);
@@ -21,6 +21,7 @@
 #include <string.h>
 #include "api.h"
 #include "cecd.h"
+#include "cecd_worker.h"
 #include "curl-handler.h"
 
 bool qr_buffer_consume(QrBuffer* buffer, u32 length) {
@@ -91,7 +92,9 @@ Result qr_dl_pass(QrBuffer* buffer) {
 		res = -1;
 		goto fail;
 	}
-	res = addStreetpassMessage(reply->ptr);
+	res = cecdWorkerRun(lambda(Result, (void* msgbuf) {
+		return addStreetpassMessage(msgbuf);
+	}), reply->ptr);
 fail:
 	curlFreeHandler(reply->offset);
 	return res;
@@ -26,154 +26,179 @@
 #include <string.h>
 #include <stdio.h>
 #include <malloc.h>
-#include <sys/stat.h>
 #include <ctype.h>
-#include <dirent.h>
 #include <unistd.h>
 #include "integration.h"
+#include "seen.h"
+#include "cec_message.h"
+#include "cec_slot.h"
+#include "report_index.h"
+#include "report_pack.h"
+#include "report_retention.h"
+#include "report_search.h"
+#include "api.h"
 
 #define LOG_DIR "sdmc:/config/netpass/log/"
-#define LOG_INDEX "sdmc:/config/netpass/log/index.nrle"
-#define LOG_SPR_DIR "sdmc:/config/netpass/log_spr/"
 
-#define MAX_REPORT_ENTRIES_LEN 128
-
-#define SETUP_ENTRY(a, x) a* body = (a*)(((u8*)buf) + buf->total_header_size); \
-	entry->data = malloc(sizeof(x)); \
-	if (!entry->data) break; \
-	x* data = (x*)entry->data; \
-	memset(data, 0, sizeof(x));
+#define SETUP_ENTRY(a, get, x, field) a* body = get(view); \
+	if (!body) break; \
+	x* data = &e->data.field; \
+	e->data_size = sizeof(x);
 
 ReportList* loadReportList(void) {
-	FILE* f = fopen(LOG_INDEX, "r");
-	if (!f) return NULL;
-
-	ReportListHeader header;
-	fread_blk(&header, sizeof(ReportListHeader), 1, f);
-	if (header.magic != 0x454C524e || header.version != 1) return NULL;
-	fseek(f, 0, SEEK_SET);
-	size_t list_file_size = sizeof(ReportListHeader) + header.max_size * sizeof(ReportSendPayload);
-	
-	ReportList* list = memalign(4, list_file_size);
-	if (!list) return NULL;
-	fread_blk(list, list_file_size, 1, f);
-	fclose(f);
-	return list;
+	return reportIndexCopy();
 }
 
-bool loadReportMessages(ReportMessages* msgs, u32 transfer_id) {
-	memset(msgs, 0, sizeof(ReportMessages));
-
-	char dirname[100];
-	snprintf(dirname, 100, "%s%lx", LOG_DIR, transfer_id);
-	size_t path_len = strlen(dirname);
+static void summarize_message(ReportSummaryEntry* e, CecMessageView* view, int pack_index) {
+	memset(e, 0, sizeof(ReportSummaryEntry));
+	e->title_id = view->header->title_id;
+	e->pack_index = pack_index;
+	// fetch the mii, if any
+	CFPB* cfpb = cecMessageFindCfpb(view);
+	if (cfpb) {
+		Result r = decryptMii(&cfpb->nonce, &e->mii);
+		e->has_mii = !R_FAILED(r) && e->mii.version == 3;
+	}
 
-	DIR* d = opendir(dirname);
-	if (!d) return false;
-	struct dirent *p;
-	CecMessageHeader* buf = malloc(MAX_MESSAGE_SIZE);
-	if (!buf) return false;
-	u16 source_ident = 0;
-	while ((p=readdir(d)) && msgs->count < 12) {
-		int fname_len = path_len + strlen(p->d_name) + 2;
-		char* fname = malloc(fname_len);
-		if (!fname) {
-			free(buf);
-			return false;
-		}
-		snprintf(fname, fname_len, "%s/%s", dirname, p->d_name);
-		// we found a file
-		FILE* f = fopen(fname, "rb");
-		if (!f) goto cont_loop;
-		fread_blk(buf, MAX_MESSAGE_SIZE, 1, f);
-		if (buf->magic != 0x6060) {
-			fclose(f);
-			goto cont_loop;
+	switch (e->title_id) {
+		case TITLE_LETTER_BOX: {
+			u32 size;
+			u8* jpegs = cecMessageLetterBoxJpegs(view, &size);
+			if (!jpegs) break;
+			// the jpegs stay in the pack, we only remember where they are
+			e->blob_offset = jpegs - view->buf;
+			e->blob_size = size;
+			break;
 		}
-		if (!source_ident) {
-			source_ident = buf->padding_sourceident;
+		case TITLE_MARIO_KART_7: {
+			SETUP_ENTRY(CecMessageBodyMarioKart7, cecMessageMarioKart7, ReportMessageEntryMarioKart7, mario_kart_7);
+			utf16_to_utf8((u8*)data->greeting, body->message, sizeof(data->greeting)-1);
+			break;
 		}
-		fclose(f);
-		// we have the file now in buf, time to populate the specific entry
-		ReportMessagesEntry* entry = &msgs->entries[msgs->count];
-		entry->title_id = buf->title_id;
-		// fetch the mii name, if any
-		CFPB* cfpb = (CFPB*)memsearch(((u8*)buf) + buf->total_header_size, buf->message_size, (u8*)"CFPB", 4);
-		if (cfpb) {
-			entry->mii = malloc(sizeof(MiiData));
-			if (entry->mii) {
-				Result r = decryptMii(&cfpb->nonce, entry->mii);
-				if (R_FAILED(r) || entry->mii->version != 3) {
-					free(entry->mii);
-					entry->mii = 0;
+		case TITLE_MII_PLAZA: {
+			SETUP_ENTRY(CecMessageBodyMiiPlaza, cecMessageMiiPlaza, ReportMessageEntryMiiPlaza, mii_plaza);
+			u8 lang = get_nintendo_language();
+			utf16_to_utf8((u8*)data->last_game, body->title[lang].short_description, sizeof(data->last_game)-1);
+			utf16_to_utf8((u8*)data->country, body->country[lang].name, sizeof(data->country)-1);
+			utf16_to_utf8((u8*)data->region, body->region[lang].name, sizeof(data->region)-1);
+			utf16_to_utf8((u8*)data->greeting, body->message, sizeof(data->greeting)-1);
+			u8* mac = getMacBuf();
+			for (int i = 0; i < 0x10; i++) {
+				if (!memcmp(mac, body->reply_list[i].mac, 6)) {
+					utf16_to_utf8((u8*)data->custom_message, body->reply_msg[i].message, sizeof(data->custom_message)-1);
+					utf16_to_utf8((u8*)data->custom_reply, body->replied_msg[i].message, sizeof(data->custom_reply)-1);
+					break;
 				}
 			}
+			break;
 		}
+		case TITLE_TOMODACHI_LIFE: {
+			SETUP_ENTRY(CecMessageBodyTomodachiLife, cecMessageTomodachiLife, ReportMessageEntryTomodachiLife, tomodachi_life);
+			utf16_to_utf8((u8*)data->island_name, body->island_name, sizeof(data->island_name)-1);
+		};
+	}
+}
 
-		switch (entry->title_id) {
-			case TITLE_LETTER_BOX: {
-				u8 needle[2] = {0xFF, 0xD8};
-				u8* ptr = memsearch(((u8*)buf) + buf->total_header_size, buf->message_size, needle, 2);
-				if (!ptr) break;
-				ptr -= 0x68 + 4;
-				u32 size = ((ReportMessagesEntryLetterBox*)ptr)->jpeg_size;
-
-				entry->data = malloc(size);
-				if (!entry->data) break;
-				memcpy(entry->data, &((ReportMessagesEntryLetterBox*)ptr)->jpegs, size);
-				break;
-			}
-			case TITLE_MARIO_KART_7: {
-				SETUP_ENTRY(CecMessageBodyMarioKart7, ReportMessageEntryMarioKart7);
-				utf16_to_utf8((u8*)data->greeting, body->message, sizeof(data->greeting)-1);
-				break;
-			}
-			case TITLE_MII_PLAZA: {
-				SETUP_ENTRY(CecMessageBodyMiiPlaza, ReportMessageEntryMiiPlaza);
-				u8 lang = get_nintendo_language();
-				utf16_to_utf8((u8*)data->last_game, body->title[lang].short_description, sizeof(data->last_game)-1);
-				utf16_to_utf8((u8*)data->country, body->country[lang].name, sizeof(data->country)-1);
-				utf16_to_utf8((u8*)data->region, body->region[lang].name, sizeof(data->region)-1);
-				utf16_to_utf8((u8*)data->greeting, body->message, sizeof(data->greeting)-1);
-				u8* mac = getMacBuf();
-				for (int i = 0; i < 0x10; i++) {
-					if (!memcmp(mac, body->reply_list[i].mac, 6)) {
-						utf16_to_utf8((u8*)data->custom_message, body->reply_msg[i].message, sizeof(data->custom_message)-1);
-						utf16_to_utf8((u8*)data->custom_reply, body->replied_msg[i].message, sizeof(data->custom_reply)-1);
-						break;
-					}
-				}
-				break;
-			}
-			case TITLE_TOMODACHI_LIFE: {
-				SETUP_ENTRY(CecMessageBodyTomodachiLife, ReportMessageEntryTomodachiLife);
-				utf16_to_utf8((u8*)data->island_name, body->island_name, sizeof(data->island_name)-1);
-			};
-		}
+static bool summarize_transfer(ReportSummary* sum, u32 transfer_id) {
+	memset(sum, 0, sizeof(ReportSummary));
+	sum->magic = 0x534C524E;
+	sum->version = REPORT_SUMMARY_VERSION;
 
-		// we don't need buf anymore so we can use it now to fetch the game name
-		memset(buf, 0, 300);
-		Result res = cecdOpenAndRead(entry->title_id, CECMESSAGE_BOX_TITLE, 198, (u8*)buf);
-		if (R_FAILED(res)) goto cont_loop;
-		char* game_name = ((char*)buf) + 200;
-		memset(game_name, 0, 100);
-		// SAFETY: utf16_to_utf8 does not write a zero terminator, so we memset above
-		int len = utf16_to_utf8((u8*)game_name, (u16*)buf, 100 - 1);
-		if (len > -1) {
-			entry->name = malloc(len+1);
-			memcpy(entry->name, game_name, len+1);
-		} else {
-			// Allocate an empty string for cleanup code
-			entry->name = malloc(1);
-			*entry->name = 0;
+	sum->language = get_nintendo_language();
+
+	ReportPack pack;
+	if (!reportPackOpen(&pack, transfer_id)) return false;
+	CecMessageHeader* buf = malloc(MAX_MESSAGE_SIZE);
+	if (!buf) {
+		reportPackClose(&pack);
+		return false;
+	}
+	sum->pack_count = pack.count;
+	for (int i = 0; i < pack.count && sum->count < 12; i++) {
+		size_t size = reportPackRead(&pack, i, buf, MAX_MESSAGE_SIZE);
+		CecMessageView view;
+		if (!size || !cecMessageViewInit(&view, (u8*)buf, size)) continue;
+		if (!sum->source_id) {
+			sum->source_id = buf->padding_sourceident;
 		}
-		msgs->count++;
-	cont_loop:
-		free(fname);
+		summarize_message(&sum->entries[sum->count++], &view, i);
 	}
 	free(buf);
-	closedir(d);
-	
+	reportPackClose(&pack);
+	return true;
+}
+
+// a sidecar that fails to write is only a missed shortcut, so this only fails if decoding does
+static bool write_summary(ReportSummary* sum, u32 transfer_id) {
+	if (!summarize_transfer(sum, transfer_id)) return false;
+	char path[100];
+	reportPackSummaryPath(path, transfer_id);
+	FILE* f = fopen(path, "wb");
+	if (!f) return true;
+	bool ok = fwrite_blk(sum, sizeof(ReportSummary), 1, f) == 1;
+	fclose(f);
+	if (!ok) unlink(path);
+	return true;
+}
+
+static bool read_summary(ReportSummary* sum, u32 transfer_id) {
+	char path[100];
+	reportPackSummaryPath(path, transfer_id);
+	FILE* f = fopen(path, "rb");
+	if (!f) return false;
+	bool ok = fread_blk(sum, sizeof(ReportSummary), 1, f) == 1;
+	fclose(f);
+	// a sidecar from an older decoder gets regenerated
+	if (!ok || sum->magic != 0x534C524E || sum->version != REPORT_SUMMARY_VERSION || sum->count > 12) return false;
+	// the mii plaza strings are in the system language
+	if (sum->language != get_nintendo_language()) return false;
+	// a reader may have decoded the pack just before a message was appended, and written its sidecar after
+	ReportPack pack;
+	if (!reportPackOpen(&pack, transfer_id)) return false;
+	bool fresh = pack.count == sum->pack_count;
+	reportPackClose(&pack);
+	return fresh;
+}
+
+bool loadReportMessages(ReportMessages* msgs, u32 transfer_id) {
+	memset(msgs, 0, sizeof(ReportMessages));
+
+	ReportSummary* sum = malloc(sizeof(ReportSummary));
+	if (!sum) return false;
+	if (!read_summary(sum, transfer_id) && !write_summary(sum, transfer_id)) {
+		free(sum);
+		return false;
+	}
+
+	ReportPack pack = { .f = NULL };
+	for (int i = 0; i < sum->count; i++) {
+		ReportSummaryEntry* e = &sum->entries[i];
+		ReportMessagesEntry* entry = &msgs->entries[msgs->count++];
+		entry->title_id = e->title_id;
+		if (e->has_mii) {
+			entry->mii = malloc(sizeof(MiiData));
+			if (entry->mii) memcpy(entry->mii, &e->mii, sizeof(MiiData));
+		}
+		if (e->data_size) {
+			entry->data = malloc(e->data_size);
+			if (entry->data) memcpy(entry->data, &e->data, e->data_size);
+		} else if (e->blob_size) {
+			// only the letter box needs to go back to the pack, and it only reads the jpegs
+			if (!pack.f) reportPackOpen(&pack, transfer_id);
+			entry->data = malloc(e->blob_size);
+			if (entry->data && (!pack.f || reportPackReadAt(&pack, e->pack_index, e->blob_offset, entry->data, e->blob_size) != e->blob_size)) {
+				free(entry->data);
+				entry->data = 0;
+			}
+		}
+
+		// the game name is whatever we last read from cecd, the UI fetches it from cecd for titles we didn't know about then
+		entry->name = getTitleName(entry->title_id);
+	}
+	reportPackClose(&pack);
+	u16 source_ident = sum->source_id;
+	free(sum);
+
 	msgs->source_name = 0;
 	msgs->source_id = source_ident;
 	IntegrationList* list = get_integration_list();
@@ -213,213 +238,169 @@ void freeReportMessages(ReportMessages* msgs) {
 	}
 }
 
-void saveSlotInLog(CecSlotHeader* slot) {
-	u8* ptr = ((u8*)slot) + sizeof(CecSlotHeader);
-	for (int i = 0; i < slot->message_count; i++) {
-		CecMessageHeader* msg = (CecMessageHeader*)ptr;
-		saveMsgInLog(msg);
-		ptr += msg->message_size;
-	}
+ReportLogBatch* reportLogBegin(void) {
+	ReportLogBatch* b = malloc(sizeof(ReportLogBatch));
+	if (!b) return NULL;
+	b->num = 0;
+	reportIndexLock();
+	return b;
 }
 
-void saveMsgInLog(CecMessageHeader* msg) {
-	ReportList* list;
-	FILE* f = fopen(LOG_INDEX, "rb");
-	if (!f) {
-		// ok, file is empty, we have to create it
-		f = fopen(LOG_INDEX, "wb");
-		if (!f) return;
-		list = memalign(4, sizeof(ReportListHeader) + sizeof(ReportListEntry) * MAX_REPORT_ENTRIES_LEN);
-		if (!list) {
-			fclose(f);
-			return;
-		}
-		memset(list, 0, sizeof(ReportListHeader) + sizeof(ReportListEntry) * MAX_REPORT_ENTRIES_LEN);
-		list->header.magic = 0x454C524e;
-		list->header.version = 1;
-		list->header.max_size = MAX_REPORT_ENTRIES_LEN;
-		list->header.cur_size = 0;
-		fwrite_blk(list, sizeof(ReportList), 1, f);
-		free(list);
-		fclose(f);
-		f = fopen(LOG_INDEX, "rb");
-		if (!f) return;
+static void log_flush(ReportLogBatch* b) {
+	ReportListEntry entries[REPORT_LOG_BATCH_MAX];
+	int num = 0;
+	for (int i = 0; i < b->num; i++) {
+		if (b->entries[i].edited) memcpy(&entries[num++], &b->entries[i].entry, sizeof(ReportListEntry));
 	}
-	size_t list_file_size;
-	{
-		ReportListHeader header;
-		fread_blk(&header, sizeof(ReportListHeader), 1, f);
-		if (header.magic != 0x454C524E || header.version != 1) return;
-		fseek(f, 0, SEEK_SET);
-		list_file_size = sizeof(ReportListHeader) + header.max_size * sizeof(ReportSendPayload);
-		list = memalign(4, list_file_size);
-		if (!list) return;
-		fread_blk(list, list_file_size, 1, f);
-		fclose(f);
+	// only the changed entries get appended, rather than rewriting the whole index
+	if (num) reportIndexPut(entries, num);
+	for (int i = 0; i < num; i++) reportSearchSetEntry(&entries[i]);
+
+	u32 grown[REPORT_LOG_BATCH_MAX];
+	int num_grown = 0;
+	ReportSummary* sum = NULL;
+	for (int i = 0; i < b->num; i++) {
+		if (!b->entries[i].summary_dirty) continue;
+		u32 transfer_id = b->entries[i].entry.transfer_id;
+		grown[num_grown++] = transfer_id;
+		// decode once now, so that opening the entry later is a single read
+		if (!sum) sum = malloc(sizeof(ReportSummary));
+		if (sum) write_summary(sum, transfer_id);
+		// the summary only holds the first 12 messages, the pack table has all of them
+		u32 title_ids[REPORT_SEARCH_MAX_TITLES];
+		int num_titles = reportPackTitles(transfer_id, title_ids, REPORT_SEARCH_MAX_TITLES);
+		if (num_titles >= 0) reportSearchSetTitles(transfer_id, title_ids, num_titles);
+	}
+	if (sum) free(sum);
+	// cleaning up after ourselves happens later, in the background
+	if (num_grown) reportRetentionTouch(grown, num_grown);
+	b->num = 0;
+}
+
+static ReportLogBatchEntry* log_batch_entry(ReportLogBatch* b, CecMessageHeader* msg) {
+	for (int i = 0; i < b->num; i++) {
+		if (b->entries[i].entry.transfer_id == msg->transfer_id) return &b->entries[i];
 	}
-	int found_i = -1;
+	if (b->num >= REPORT_LOG_BATCH_MAX) log_flush(b);
+	ReportList* list = reportIndexGet();
+	if (!list) return NULL;
+	ReportLogBatchEntry* be = &b->entries[b->num];
+	memset(be, 0, sizeof(ReportLogBatchEntry));
 	// find if the transfer id already exists
-	for (int i = 0; i < list->header.cur_size; i++) {
-		if (list->entries[i].transfer_id == msg->transfer_id) {
-			found_i = i;
-			break;
+	ReportListEntry* found = reportIndexFind(msg->transfer_id);
+	if (found) {
+		memcpy(&be->entry, found, sizeof(ReportListEntry));
+	} else {
+		// we have to add a new entry! The ones still in the batch have to fit, too
+		int num_new = 0;
+		for (int i = 0; i < b->num; i++) {
+			if (!reportIndexFind(b->entries[i].entry.transfer_id)) num_new++;
 		}
-	}
-	char* b64name = b64encode(msg->message_id, 8);
-	char filename[100];
-	snprintf(filename, 100, "%s%lx/_%s", LOG_DIR, msg->transfer_id, b64name);
-	free(b64name);
-	bool edited = false;
-	if (found_i < 0) {
-		// we have to add a new entry!
-		if (list->header.max_size == list->header.cur_size) {
-			// uho, all is full, gotta the first half of the list
-			int i = 0;
-			for (; i < MAX_REPORT_ENTRIES_LEN / 2; i++) {
-				u32 rm_batch = list->entries[i].transfer_id;
-				char rm_dirname[100];
-				snprintf(rm_dirname, 100, "%s%lx", LOG_DIR, rm_batch);
-				rmdir_r(rm_dirname);
-				list->header.cur_size--;
+		if (list->header.cur_size + num_new >= REPORT_INDEX_MAX_ENTRIES) {
+			log_flush(b);
+			be = &b->entries[0];
+			memset(be, 0, sizeof(ReportLogBatchEntry));
+			// the retention engine normally keeps us well below this, it just didn't get to it yet.
+			// So only make room for this one, the rest is up to it
+			if (list->header.cur_size) {
+				u32 oldest = list->entries[0].transfer_id;
+				reportIndexRemove(&oldest, 1);
+				reportPackDelete(oldest);
 			}
-			memmove(list->entries, ((u8*)list->entries) + sizeof(ReportListEntry)*i, list->header.cur_size * sizeof(ReportListEntry));
 		}
-		ReportListEntry* e = &list->entries[list->header.cur_size];
-		e->transfer_id = msg->transfer_id;
-		memcpy(&e->received, &msg->received, sizeof(CecTimestamp));
-		found_i = list->header.cur_size;
-		list->header.cur_size++;
-		edited = true;
+		be->entry.transfer_id = msg->transfer_id;
+		memcpy(&be->entry.received, &msg->received, sizeof(CecTimestamp));
+		be->edited = true;
 	}
-	ReportListEntry* e = &list->entries[found_i];
-	if (msg->title_id == TITLE_MII_PLAZA) {
-		CecMessageBodyMiiPlaza* body = (CecMessageBodyMiiPlaza*)(((u8*)msg) + msg->total_header_size);
-		static const int cfpb_offset = 0x36bc;
-		static const int cfpb_size = 0x88;
-		if (msg->message_size > msg->total_header_size + cfpb_offset + cfpb_size) {
-			if (body->cfpb.magic == 0x42504643) {
-				int prev_mii_id = e->mii.version == 3 ? e->mii.mii_id : 0;
-				Result r = decryptMii(&body->cfpb.nonce, &e->mii);
-				if (!R_FAILED(r) && prev_mii_id != e->mii.mii_id) edited = true;
-			}
+	b->num++;
+	return be;
+}
+
+bool reportLogAdd(ReportLogBatch* b, CecMessageHeader* msg) {
+	// retransmits and re-imports would otherwise rewrite the index for nothing
+	if (seenContains(SEEN_LOG, msg->title_id, msg->message_id)) return true;
+	ReportLogBatchEntry* be = log_batch_entry(b, msg);
+	if (!be) return false;
+	ReportListEntry* e = &be->entry;
+	CecMessageView view;
+	bool valid = cecMessageViewInit(&view, (u8*)msg, msg->message_size);
+	// decrypting goes through APT, so we only do it once per transfer
+	if (valid && !be->mii_done && msg->title_id == TITLE_MII_PLAZA) {
+		// the mii is at a fixed offset, unless the body is shorter than we expect
+		CecMessageBodyMiiPlaza* body = cecMessageMiiPlaza(&view);
+		CFPB* cfpb = body ? &body->cfpb : cecMessageFindCfpb(&view);
+		if (cfpb && cfpb->magic == 0x42504643) {
+			int prev_mii_id = e->mii.version == 3 ? e->mii.mii_id : 0;
+			Result r = decryptMii(&cfpb->nonce, &e->mii);
+			if (!R_FAILED(r)) be->mii_done = true;
+			if (!R_FAILED(r) && prev_mii_id != e->mii.mii_id) be->edited = true;
 		}
-	} else if (e->mii.version != 3) {
+	} else if (valid && !be->mii_done && e->mii.version != 3) {
 		// search if there is a mii in this payload
-		CFPB* cfpb = (CFPB*)memsearch(((u8*)msg) + msg->total_header_size, msg->message_size, (u8*)"CFPB", 4);
+		CFPB* cfpb = cecMessageFindCfpb(&view);
 		if (cfpb) {
 			Result r = decryptMii(&cfpb->nonce, &e->mii);
-			if (!R_FAILED(r)) edited = true;
+			if (!R_FAILED(r)) be->mii_done = be->edited = true;
 		}
 	}
 
-	if (edited) {
-		f = fopen(LOG_INDEX, "wb");
-		if (!f) goto error;
-		fwrite_blk(list, list_file_size, 1, f);
-		fclose(f);
+	if (!reportPackAppend(msg->transfer_id, msg)) return false;
+	be->summary_dirty = true;
+	seenAdd(SEEN_LOG, msg->title_id, msg->message_id);
+	return true;
+}
+
+bool reportLogAddSlot(ReportLogBatch* b, CecSlotHeader* slot) {
+	CecSlotIter it;
+	CecMessageView view;
+	bool ok = true;
+	cecSlotIterInit(&it, (u8*)slot, slot->size);
+	while (cecSlotIterNext(&it, &view)) {
+		if (!reportLogAdd(b, view.header)) ok = false;
 	}
-	mkdir_p(filename);
-	f = fopen(filename, "wb");
-	if (!f) goto error;
-	fwrite_blk(msg, msg->message_size, 1, f);
-	fclose(f);
+	return ok;
+}
 
-error:
-	free(list);
+void reportLogCommit(ReportLogBatch* b) {
+	log_flush(b);
+	seenFlush();
+	reportIndexUnlock();
+	free(b);
 }
 
-Result reportGetSomeMsgHeader(CecMessageHeader* msg, u32 transfer_id) {
-	msg->magic = 0;
+void saveSlotInLog(CecSlotHeader* slot) {
+	ReportLogBatch* b = reportLogBegin();
+	if (!b) return;
+	reportLogAddSlot(b, slot);
+	reportLogCommit(b);
+}
 
-	char dirname[100];
-	snprintf(dirname, 100, "%s%lx", LOG_DIR, transfer_id);
-	size_t path_len = strlen(dirname);
+void saveMsgInLog(CecMessageHeader* msg) {
+	ReportLogBatch* b = reportLogBegin();
+	if (!b) return;
+	reportLogAdd(b, msg);
+	reportLogCommit(b);
+}
 
-	DIR* d = opendir(dirname);
-	if (!d) return -1;
+Result reportGetSomeMsgHeader(CecMessageHeader* msg, u32 transfer_id) {
+	msg->magic = 0;
 
-	struct dirent *p;
-	while ((p=readdir(d))) {
-		int fname_len = path_len + strlen(p->d_name) + 2;
-		char* fname = malloc(fname_len);
-		if (!fname) {
-			closedir(d);
-			return -1;
-		}
-		snprintf(fname, fname_len, "%s/%s", dirname, p->d_name);
-		// we found a file
-		FILE* f = fopen(fname, "rb");
-		if (f) {
-			fread_blk(msg, sizeof(CecMessageHeader), 1, f);
-			fclose(f);
-			if (msg->magic == 0x6060 && msg->transfer_id == transfer_id) {
-				free(fname);
-				break;
-			} else {
-				msg->magic = 0;
-			}
+	ReportPack pack;
+	if (!reportPackOpen(&pack, transfer_id)) return -1;
+	for (int i = 0; i < pack.count; i++) {
+		if (reportPackRead(&pack, i, msg, sizeof(CecMessageHeader)) == sizeof(CecMessageHeader)
+			&& msg->magic == 0x6060 && msg->transfer_id == transfer_id) {
+			break;
 		}
-		free(fname);
+		msg->magic = 0;
 	}
-	closedir(d);
+	reportPackClose(&pack);
 
-	if (!msg->magic) return -2; // nothing in directory
+	if (!msg->magic) return -2; // nothing in the pack
 
 	return 0;
 }
 
 void reportInit(void) {
 	mkdir_p(LOG_DIR);
-	mkdir_p(LOG_SPR_DIR);
-
-	DIR* d = opendir(LOG_SPR_DIR);
-	if (!d) return;
-	struct dirent* p;
-	char filename[200];
-	bool has_spr_passes = false;
-	while ((p = readdir(d))) {
-		size_t len = strlen(LOG_SPR_DIR) + strlen(p->d_name) + 1;
-		struct stat statbuf;
-		snprintf(filename, len, "%s%s", LOG_SPR_DIR, p->d_name);
-		if (stat(filename, &statbuf) && !S_ISDIR(statbuf.st_mode)) continue;
-		if (!has_spr_passes) {
-			has_spr_passes = true;
-			printf("Add SPR passes ");
-		}
-		FILE* f = fopen(filename, "rb");
-		if (!f) continue;
-		fseek(f, 0, SEEK_END);
-		size_t filesize = ftell(f);
-		rewind(f);
-		if (filesize < sizeof(CecSlotHeader)) {
-			fclose(f);
-			printf("/");
-			unlink(filename);
-			continue;
-		}
-		CecSlotHeader slot;
-		fread_blk(&slot, sizeof(CecSlotHeader), 1, f);
-		if (slot.size > MAX_SLOT_SIZE) {
-			fclose(f);
-			printf("S");
-			unlink(filename);
-			continue;
-		}
-		CecSlotHeader* buf_slot = malloc(slot.size);
-		if (!buf_slot) {
-			printf("B");
-			fclose(f);
-			unlink(filename);
-			continue;
-		}
-		rewind(f);
-		fread_blk(buf_slot, slot.size, 1, f);
-		fclose(f);
-		printf("=");
-		saveSlotInLog(buf_slot);
-		free(buf_slot);
-		unlink(filename);
-	}
-	closedir(d);
-	if (has_spr_passes) printf(" Done\n");
 }
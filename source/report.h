@@ -73,6 +73,39 @@ typedef struct {
 	char island_name[17];
 } ReportMessageEntryTomodachiLife;
 
+// bump this whenever the decoding into the summary changes, old sidecars get regenerated then
+#define REPORT_SUMMARY_VERSION 3
+
+typedef struct {
+	u32 title_id;
+	u8 has_mii;
+	u8 padding;
+	u16 pack_index; // chained packs can hold more than 256 messages
+	u16 data_size;
+	u16 padding2;
+	u32 blob_offset; // letter box jpegs, relative to the message in the pack
+	u32 blob_size;
+	MiiData mii;
+	union {
+		ReportMessageEntryMarioKart7 mario_kart_7;
+		ReportMessageEntryMiiPlaza mii_plaza;
+		ReportMessageEntryTomodachiLife tomodachi_life;
+	} data;
+} ReportSummaryEntry;
+
+// The decoded messages of a transfer, stored next to its pack
+typedef struct {
+	u32 magic; // 0x534C524E "NRLS"
+	int version; // REPORT_SUMMARY_VERSION
+	u16 source_id;
+	u16 count;
+	// the sidecar is stale once the pack has more messages or the system language changed
+	u32 pack_count;
+	u8 language;
+	u8 padding[3];
+	ReportSummaryEntry entries[12];
+} ReportSummary;
+
 typedef struct {
 	char* name;
 	u32 title_id;
@@ -87,6 +120,27 @@ typedef struct {
 	ReportMessagesEntry entries[12];
 } ReportMessages;
 
+#define REPORT_LOG_BATCH_MAX 16
+
+typedef struct {
+	ReportListEntry entry;
+	bool edited;
+	bool mii_done;
+	bool summary_dirty;
+} ReportLogBatchEntry;
+
+typedef struct {
+	int num;
+	ReportLogBatchEntry entries[REPORT_LOG_BATCH_MAX];
+} ReportLogBatch;
+
+// Writing many messages to the log at once touches the index only once per transfer.
+// The log stays locked until reportLogCommit, which also frees the batch
+ReportLogBatch* reportLogBegin(void);
+// false if a message didn't make it into the log
+bool reportLogAdd(ReportLogBatch* b, CecMessageHeader* msg);
+bool reportLogAddSlot(ReportLogBatch* b, CecSlotHeader* slot);
+void reportLogCommit(ReportLogBatch* b);
 void saveSlotInLog(CecSlotHeader* slot);
 void saveMsgInLog(CecMessageHeader* msg);
 ReportList* loadReportList(void);
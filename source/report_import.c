@@ -0,0 +1,197 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report_import.h"
+#include "report.h"
+#include "report_index.h"
+#include "report_search.h"
+#include "cec_slot.h"
+#include "utils.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define LOG_SPR_DIR "sdmc:/config/netpass/log_spr/"
+#define FILENAME_LEN 200
+
+static LightLock import_lock;
+static Thread import_thread = NULL;
+static bool import_running = false;
+static int import_done = 0;
+static int import_total = 0;
+
+static void set_progress(int done, int total) {
+	LightLock_Lock(&import_lock);
+	import_done = done;
+	if (total >= 0) import_total = total;
+	LightLock_Unlock(&import_lock);
+}
+
+enum {
+	IMPORT_FILE_DONE,
+	IMPORT_FILE_SKIPPED, // could not be opened or logged, it stays for the next run
+	IMPORT_FILE_STOPPED, // got stopped halfway through, the file has to stay then
+};
+
+static int import_file(ReportLogBatch* log_batch, const char* filename, u8* msgbuf) {
+	FILE* f = fopen(filename, "rb");
+	if (!f) {
+		printf("?");
+		return IMPORT_FILE_SKIPPED;
+	}
+	fseek(f, 0, SEEK_END);
+	size_t filesize = ftell(f);
+	rewind(f);
+	// only one message at a time has to be in memory, rather than the whole slot
+	CecSlotStream stream;
+	if (!cecSlotStreamInit(&stream, f, filesize)) {
+		fclose(f);
+		printf("/");
+		return IMPORT_FILE_DONE;
+	}
+	CecMessageView view;
+	bool finished = true;
+	bool logged = true;
+	while (cecSlotStreamNext(&stream, msgbuf, MAX_MESSAGE_SIZE, &view)) {
+		// the ones that did make it are in the seen filter, so the next run only retries the rest
+		if (!reportLogAdd(log_batch, view.header)) logged = false;
+		if (!import_running) {
+			finished = false;
+			break;
+		}
+	}
+	fclose(f);
+	if (!finished) return IMPORT_FILE_STOPPED;
+	if (!logged) {
+		printf("?");
+		return IMPORT_FILE_SKIPPED;
+	}
+	printf(stream.error ? "-" : "=");
+	return IMPORT_FILE_DONE;
+}
+
+static bool is_file(const char* filename) {
+	struct stat statbuf;
+	return !stat(filename, &statbuf) && S_ISREG(statbuf.st_mode);
+}
+
+static int count_files(void) {
+	DIR* d = opendir(LOG_SPR_DIR);
+	if (!d) return 0;
+	int num = 0;
+	struct dirent* p;
+	while ((p = readdir(d))) {
+		char filename[FILENAME_LEN];
+		snprintf(filename, FILENAME_LEN, "%s%s", LOG_SPR_DIR, p->d_name);
+		if (is_file(filename)) num++;
+	}
+	closedir(d);
+	return num;
+}
+
+static void import_worker(void* arg) {
+	int total = count_files();
+	set_progress(0, total);
+	DIR* d = total ? opendir(LOG_SPR_DIR) : NULL;
+	u8* msgbuf = d ? malloc(MAX_MESSAGE_SIZE) : NULL;
+	char (*done_files)[FILENAME_LEN] = d ? malloc(REPORT_IMPORT_FILES_PER_COMMIT * FILENAME_LEN) : NULL;
+	if (d && (!msgbuf || !done_files)) {
+		printf("B");
+		closedir(d);
+		d = NULL;
+	}
+	if (d) printf("Add SPR passes ");
+	int done = 0;
+	struct dirent* p;
+	while (d && import_running) {
+		// a handful of files share one index commit, and the lock is given back in between
+		ReportLogBatch* log_batch = reportLogBegin();
+		if (!log_batch) break;
+		int num_done_files = 0;
+		int num_skipped = 0;
+		bool more = false;
+		while (num_done_files < REPORT_IMPORT_FILES_PER_COMMIT && import_running && (p = readdir(d))) {
+			char* filename = done_files[num_done_files];
+			snprintf(filename, FILENAME_LEN, "%s%s", LOG_SPR_DIR, p->d_name);
+			if (!is_file(filename)) continue;
+			int res = import_file(log_batch, filename, msgbuf);
+			if (res == IMPORT_FILE_STOPPED) break;
+			more = true;
+			if (res == IMPORT_FILE_SKIPPED) {
+				num_skipped++;
+				continue;
+			}
+			num_done_files++;
+		}
+		reportLogCommit(log_batch);
+		// only now that it is in the index the files can go
+		for (int i = 0; i < num_done_files; i++) {
+			unlink(done_files[i]);
+		}
+		done += num_done_files + num_skipped;
+		set_progress(done, -1);
+		if (!more) break;
+	}
+	if (d) {
+		closedir(d);
+		printf(import_running ? " Done\n" : " Paused\n");
+	}
+	if (msgbuf) free(msgbuf);
+	if (done_files) free(done_files);
+	reportIndexLock();
+	reportIndexCompact(false);
+	reportIndexUnlock();
+	reportSearchBackfill(&import_running);
+	DEBUG_PRINTF("Imported %d of %d SPR files\n", done, total);
+	LightLock_Lock(&import_lock);
+	import_running = false;
+	LightLock_Unlock(&import_lock);
+}
+
+void reportImportStart(void) {
+	if (import_thread) return;
+	LightLock_Init(&import_lock);
+	mkdir_p(LOG_SPR_DIR);
+	import_running = true;
+	import_thread = threadCreate(import_worker, NULL, 16*1024, main_thread_prio()+1, -2, false);
+	if (!import_thread) import_running = false;
+}
+
+void reportImportExit(void) {
+	if (!import_thread) return;
+	import_running = false;
+	threadJoin(import_thread, U64_MAX);
+	threadFree(import_thread);
+	import_thread = NULL;
+}
+
+void reportImportGetProgress(ReportImportProgress* progress) {
+	if (!import_thread) {
+		memset(progress, 0, sizeof(ReportImportProgress));
+		return;
+	}
+	LightLock_Lock(&import_lock);
+	progress->done = import_done;
+	progress->total = import_total;
+	progress->running = import_running;
+	LightLock_Unlock(&import_lock);
+}
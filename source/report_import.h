@@ -0,0 +1,36 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+
+// Passes relayed over SPR are dropped into log_spr/ as slot files, this moves them into the log
+// in the background. A file only gets removed once everything in it is committed to the index, and
+// logging a message twice is a no-op, so an import that gets cut short just carries on next time
+#define REPORT_IMPORT_FILES_PER_COMMIT 8
+
+typedef struct {
+	int done;
+	int total;
+	bool running;
+} ReportImportProgress;
+
+void reportImportStart(void);
+void reportImportExit(void);
+void reportImportGetProgress(ReportImportProgress* progress);
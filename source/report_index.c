@@ -0,0 +1,203 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "report_index.h"
+#include "utils.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#define INDEX_PATH "sdmc:/config/netpass/log/index.nrle"
+#define INDEX_TMP_PATH "sdmc:/config/netpass/log/index.nrle.tmp"
+#define JOURNAL_PATH "sdmc:/config/netpass/log/index.nrlj"
+#define LIST_SIZE (sizeof(ReportListHeader) + sizeof(ReportListEntry) * REPORT_INDEX_MAX_ENTRIES)
+
+static LightLock index_lock;
+static ReportList* list = NULL;
+static int journal_records = 0;
+
+void reportIndexInit(void) {
+	LightLock_Init(&index_lock);
+}
+
+void reportIndexLock(void) {
+	LightLock_Lock(&index_lock);
+}
+
+void reportIndexUnlock(void) {
+	LightLock_Unlock(&index_lock);
+}
+
+bool reportIndexTryLock(void) {
+	return LightLock_TryLock(&index_lock) == 0;
+}
+
+static bool read_snapshot(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if (!f) return false;
+	ReportListHeader header;
+	if (fread_blk(&header, sizeof(ReportListHeader), 1, f) != 1 || header.magic != 0x454C524E || header.version != 1) {
+		fclose(f);
+		return false;
+	}
+	size_t num = header.cur_size;
+	if (num > header.max_size) num = header.max_size;
+	// if the snapshot has more than we have room for, we keep the newest ones
+	if (num > REPORT_INDEX_MAX_ENTRIES) {
+		fseek(f, (num - REPORT_INDEX_MAX_ENTRIES) * sizeof(ReportListEntry), SEEK_CUR);
+		num = REPORT_INDEX_MAX_ENTRIES;
+	}
+	list->header.cur_size = fread_blk(list->entries, sizeof(ReportListEntry), num, f);
+	fclose(f);
+	return true;
+}
+
+static void apply(ReportListEntry* entry) {
+	ReportListEntry* e = reportIndexFind(entry->transfer_id);
+	if (!e) {
+		if (list->header.cur_size >= REPORT_INDEX_MAX_ENTRIES) return;
+		e = &list->entries[list->header.cur_size++];
+	}
+	memcpy(e, entry, sizeof(ReportListEntry));
+}
+
+static void remove_entry(u32 transfer_id) {
+	ReportListEntry* e = reportIndexFind(transfer_id);
+	if (!e) return;
+	int i = e - list->entries;
+	list->header.cur_size--;
+	memmove(e, e + 1, (list->header.cur_size - i) * sizeof(ReportListEntry));
+}
+
+static void replay_journal(void) {
+	journal_records = 0;
+	FILE* f = fopen(JOURNAL_PATH, "rb");
+	if (!f) return;
+	ReportJournalRecord r;
+	while (fread_blk(&r, sizeof(ReportJournalRecord), 1, f) == 1) {
+		journal_records++;
+		// a torn or corrupted record only costs us that one change
+		if ((r.magic != 0x4A52 && r.magic != 0x4A44) || r.crc != crc16_ccitt(&r.entry, sizeof(ReportListEntry), 0)) continue;
+		if (r.magic == 0x4A44) {
+			remove_entry(r.entry.transfer_id);
+		} else {
+			apply(&r.entry);
+		}
+	}
+	fclose(f);
+}
+
+static bool load(void) {
+	if (list) return true;
+	list = memalign(4, LIST_SIZE);
+	if (!list) return false;
+	memset(list, 0, LIST_SIZE);
+	list->header.magic = 0x454C524E;
+	list->header.version = 1;
+	list->header.max_size = REPORT_INDEX_MAX_ENTRIES;
+	// a compaction that got interrupted between removing and renaming leaves the tmp file
+	if (!read_snapshot(INDEX_PATH)) read_snapshot(INDEX_TMP_PATH);
+	replay_journal();
+	DEBUG_PRINTF("Loaded %d log entries, %d journal records\n", list->header.cur_size, journal_records);
+	return true;
+}
+
+ReportList* reportIndexGet(void) {
+	if (!load()) return NULL;
+	return list;
+}
+
+ReportListEntry* reportIndexFind(u32 transfer_id) {
+	if (!load()) return NULL;
+	for (int i = 0; i < list->header.cur_size; i++) {
+		if (list->entries[i].transfer_id == transfer_id) return &list->entries[i];
+	}
+	return NULL;
+}
+
+bool reportIndexPut(ReportListEntry* entries, int num) {
+	if (!load()) return false;
+	FILE* f = fopen(JOURNAL_PATH, "ab");
+	bool ok = f != NULL;
+	for (int i = 0; i < num; i++) {
+		apply(&entries[i]);
+		if (!f) continue;
+		ReportJournalRecord r;
+		r.magic = 0x4A52;
+		memcpy(&r.entry, &entries[i], sizeof(ReportListEntry));
+		r.crc = crc16_ccitt(&r.entry, sizeof(ReportListEntry), 0);
+		if (fwrite_blk(&r, sizeof(ReportJournalRecord), 1, f) != 1) ok = false;
+		journal_records++;
+	}
+	if (f) fclose(f);
+	return ok;
+}
+
+bool reportIndexRemove(const u32* transfer_ids, int num) {
+	if (!load()) return false;
+	FILE* f = fopen(JOURNAL_PATH, "ab");
+	bool ok = f != NULL;
+	for (int i = 0; i < num; i++) {
+		remove_entry(transfer_ids[i]);
+		if (!f) continue;
+		ReportJournalRecord r;
+		memset(&r, 0, sizeof(ReportJournalRecord));
+		r.magic = 0x4A44;
+		r.entry.transfer_id = transfer_ids[i];
+		r.crc = crc16_ccitt(&r.entry, sizeof(ReportListEntry), 0);
+		if (fwrite_blk(&r, sizeof(ReportJournalRecord), 1, f) != 1) ok = false;
+		journal_records++;
+	}
+	if (f) fclose(f);
+	return ok;
+}
+
+void reportIndexCompact(bool force) {
+	if (!load()) return;
+	if (!force && journal_records < REPORT_JOURNAL_MAX_RECORDS) return;
+	FILE* f = fopen(INDEX_TMP_PATH, "wb");
+	if (!f) return;
+	size_t size = sizeof(ReportListHeader) + list->header.cur_size * sizeof(ReportListEntry);
+	bool ok = fwrite_blk(list, size, 1, f) == 1;
+	fclose(f);
+	if (!ok) {
+		unlink(INDEX_TMP_PATH);
+		return;
+	}
+	// replaying the journal on top of the new snapshot changes nothing, so it only goes once that is in place
+	unlink(INDEX_PATH);
+	if (rename(INDEX_TMP_PATH, INDEX_PATH)) return;
+	unlink(JOURNAL_PATH);
+	journal_records = 0;
+}
+
+ReportList* reportIndexCopy(void) {
+	reportIndexLock();
+	ReportList* copy = NULL;
+	if (load()) {
+		size_t size = sizeof(ReportListHeader) + list->header.cur_size * sizeof(ReportListEntry);
+		copy = memalign(4, size);
+		if (copy) memcpy(copy, list, size);
+	}
+	reportIndexUnlock();
+	return copy;
+}
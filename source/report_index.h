@@ -0,0 +1,52 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <3ds.h>
+#include "report.h"
+
+// The report index lives in index.nrle as a snapshot, plus a journal of changed
+// entries appended after it. Every change is a single record appended to the journal,
+// and the journal gets folded back into the snapshot once it grows too long
+#define REPORT_INDEX_MAX_ENTRIES 1024
+#define REPORT_JOURNAL_MAX_RECORDS 64
+
+typedef struct {
+	u16 magic; // 0x4A52 "RJ", or 0x4A44 "DJ" to remove the entry with that transfer id
+	u16 crc; // crc16 over the entry
+	ReportListEntry entry;
+} ReportJournalRecord;
+
+void reportIndexInit(void);
+// all the functions below have to be called with the lock held, except for reportIndexCopy
+void reportIndexLock(void);
+void reportIndexUnlock(void);
+// for background work that would rather come back later than wait
+bool reportIndexTryLock(void);
+ReportList* reportIndexGet(void);
+ReportListEntry* reportIndexFind(u32 transfer_id);
+// adds or replaces the entries with the same transfer id
+bool reportIndexPut(ReportListEntry* entries, int num);
+// removes the entries with these transfer ids, if they are still there
+bool reportIndexRemove(const u32* transfer_ids, int num);
+// with force unset, this only compacts once the journal is long enough
+void reportIndexCompact(bool force);
+// a copy of the index for the UI, free it when done
+ReportList* reportIndexCopy(void);
@@ -0,0 +1,322 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report_pack.h"
+#include "utils.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define LOG_DIR "sdmc:/config/netpass/log/"
+
+// the exchange, the import and the prefetch worker may all get at the same transfer, so
+// creating, migrating, appending to and deleting packs happens one at a time
+static LightLock pack_lock;
+
+void reportPackInit(void) {
+	LightLock_Init(&pack_lock);
+}
+
+static void pack_path(char* path, u32 transfer_id) {
+	snprintf(path, 100, "%s%lx.nrlp", LOG_DIR, transfer_id);
+}
+
+void reportPackSummaryPath(char* path, u32 transfer_id) {
+	snprintf(path, 100, "%s%lx.nrls", LOG_DIR, transfer_id);
+}
+
+static void init_table(ReportPackTable* table) {
+	memset(table, 0, sizeof(ReportPackTable));
+	table->magic = 0x504C524E;
+	table->version = 1;
+}
+
+// reads the whole chain of tables into pack, every table but the last one is full
+static bool load(FILE* f, ReportPack* pack) {
+	ReportPackTable table;
+	u32 offset = 0;
+	pack->f = f;
+	for (int n = 0; n < REPORT_PACK_MAX_TABLES; n++) {
+		if (fseek(f, offset, SEEK_SET) || fread_blk(&table, sizeof(ReportPackTable), 1, f) != 1
+			|| table.magic != 0x504C524E || table.version != 1 || table.count > REPORT_PACK_TABLE_SIZE) break;
+		// room for the whole table, so appending to the last one never has to grow it
+		ReportPackEntry* entries = realloc(pack->entries, (pack->count + REPORT_PACK_TABLE_SIZE) * sizeof(ReportPackEntry));
+		if (!entries) break;
+		pack->entries = entries;
+		memcpy(&pack->entries[pack->count], table.entries, table.count * sizeof(ReportPackEntry));
+		pack->count += table.count;
+		pack->tail = offset;
+		pack->tail_count = table.count;
+		if (!table.next) return true;
+		if (table.count < REPORT_PACK_TABLE_SIZE || table.next <= offset) break;
+		offset = table.next;
+	}
+	if (pack->entries) free(pack->entries);
+	pack->entries = NULL;
+	pack->count = 0;
+	pack->f = NULL;
+	return false;
+}
+
+static bool append(ReportPack* pack, CecMessageHeader* msg) {
+	for (int i = 0; i < pack->count; i++) {
+		if (!memcmp(pack->entries[i].message_id, msg->message_id, sizeof(CecMessageId))) return true;
+	}
+	FILE* f = pack->f;
+	if (pack->tail_count >= REPORT_PACK_TABLE_SIZE) {
+		if (pack->count >= REPORT_PACK_TABLE_SIZE * (REPORT_PACK_MAX_TABLES - 1)) return false;
+		ReportPackEntry* entries = realloc(pack->entries, (pack->count + REPORT_PACK_TABLE_SIZE) * sizeof(ReportPackEntry));
+		if (!entries) return false;
+		pack->entries = entries;
+		ReportPackTable table;
+		init_table(&table);
+		fseek(f, 0, SEEK_END);
+		u32 offset = ftell(f);
+		if (fwrite_blk(&table, sizeof(ReportPackTable), 1, f) != 1) return false;
+		// a torn write leaves a table nobody points at, which is only wasted space
+		fseek(f, pack->tail + offsetof(ReportPackTable, next), SEEK_SET);
+		if (fwrite_blk(&offset, sizeof(u32), 1, f) != 1) return false;
+		pack->tail = offset;
+		pack->tail_count = 0;
+	}
+	fseek(f, 0, SEEK_END);
+	ReportPackEntry* e = &pack->entries[pack->count];
+	memcpy(e->message_id, msg->message_id, sizeof(CecMessageId));
+	e->title_id = msg->title_id;
+	e->offset = ftell(f);
+	e->size = msg->message_size;
+	if (fwrite_blk(msg, msg->message_size, 1, f) != 1) return false;
+	char path[100];
+	reportPackSummaryPath(path, msg->transfer_id);
+	unlink(path);
+	// the blob goes first, so a torn write never makes the table point at garbage
+	u32 count = pack->tail_count + 1;
+	fseek(f, pack->tail + offsetof(ReportPackTable, entries) + pack->tail_count * sizeof(ReportPackEntry), SEEK_SET);
+	if (fwrite_blk(e, sizeof(ReportPackEntry), 1, f) != 1) return false;
+	fseek(f, pack->tail + offsetof(ReportPackTable, count), SEEK_SET);
+	if (fwrite_blk(&count, sizeof(u32), 1, f) != 1) return false;
+	pack->count++;
+	pack->tail_count++;
+	return true;
+}
+
+static bool create_pack(const char* path, ReportPack* pack) {
+	ReportPackTable table;
+	init_table(&table);
+	pack->entries = malloc(REPORT_PACK_TABLE_SIZE * sizeof(ReportPackEntry));
+	FILE* f = pack->entries ? fopen(path, "w+b") : NULL;
+	if (f && fwrite_blk(&table, sizeof(ReportPackTable), 1, f) == 1) {
+		pack->f = f;
+		return true;
+	}
+	if (f) {
+		fclose(f);
+		unlink(path);
+	}
+	if (pack->entries) free(pack->entries);
+	pack->entries = NULL;
+	return false;
+}
+
+// packs up a directory from before the pack format into pack.
+// The pack is built under a temporary name, so the directory only goes once the pack is complete
+static bool migrate(u32 transfer_id, char* dirname, ReportPack* pack) {
+	DIR* d = opendir(dirname);
+	if (!d) return false;
+	char path[100];
+	char tmp_path[100 + 4];
+	pack_path(path, transfer_id);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	CecMessageHeader* buf = malloc(MAX_MESSAGE_SIZE);
+	if (!buf || !create_pack(tmp_path, pack)) {
+		if (buf) free(buf);
+		closedir(d);
+		return false;
+	}
+	struct dirent* p;
+	bool ok = true;
+	while ((p = readdir(d))) {
+		char fname[100 + 20];
+		snprintf(fname, sizeof(fname), "%s/%s", dirname, p->d_name);
+		FILE* mf = fopen(fname, "rb");
+		if (!mf) continue;
+		fseek(mf, 0, SEEK_END);
+		size_t len = ftell(mf);
+		rewind(mf);
+		if (len > MAX_MESSAGE_SIZE) len = MAX_MESSAGE_SIZE;
+		bool read_ok = len >= sizeof(CecMessageHeader) && fread_blk(buf, len, 1, mf) == 1;
+		fclose(mf);
+		if (!read_ok || buf->magic != 0x6060 || buf->message_size > len) continue;
+		if (!append(pack, buf)) {
+			ok = false;
+			break;
+		}
+	}
+	closedir(d);
+	free(buf);
+	u32 count = pack->count;
+	reportPackClose(pack);
+	if (!ok || rename(tmp_path, path)) {
+		// keep the directory around, we try again next time
+		unlink(tmp_path);
+		return false;
+	}
+	FILE* f = fopen(path, "r+b");
+	if (!f) return false;
+	if (!load(f, pack)) {
+		fclose(f);
+		return false;
+	}
+	DEBUG_PRINTF("Packed log %lx, %lu messages\n", transfer_id, count);
+	rmdir_r(dirname);
+	return true;
+}
+
+// a new pack is only made if there is neither a pack nor a directory from before it.
+// A pack that doesn't read or a directory that fails to migrate is left alone for the next try
+static bool open_pack(u32 transfer_id, ReportPack* pack, bool create) {
+	char path[100];
+	struct stat st;
+	memset(pack, 0, sizeof(ReportPack));
+	pack_path(path, transfer_id);
+	if (!stat(path, &st)) {
+		FILE* f = fopen(path, "r+b");
+		if (!f) return false;
+		if (load(f, pack)) return true;
+		fclose(f);
+		return false;
+	}
+	char dirname[100];
+	snprintf(dirname, 100, "%s%lx", LOG_DIR, transfer_id);
+	if (!stat(dirname, &st)) return migrate(transfer_id, dirname, pack);
+	return create && create_pack(path, pack);
+}
+
+bool reportPackOpen(ReportPack* pack, u32 transfer_id) {
+	// appends only ever add to the end and then the table, so reading on without the lock is fine
+	LightLock_Lock(&pack_lock);
+	bool ok = open_pack(transfer_id, pack, false);
+	LightLock_Unlock(&pack_lock);
+	return ok;
+}
+
+void reportPackClose(ReportPack* pack) {
+	if (pack->f) fclose(pack->f);
+	pack->f = NULL;
+	if (pack->entries) free(pack->entries);
+	pack->entries = NULL;
+	pack->count = 0;
+}
+
+size_t reportPackRead(ReportPack* pack, int i, void* buf, size_t buf_size) {
+	return reportPackReadAt(pack, i, 0, buf, buf_size);
+}
+
+size_t reportPackReadAt(ReportPack* pack, int i, u32 offset, void* buf, size_t buf_size) {
+	if (i < 0 || i >= pack->count) return 0;
+	ReportPackEntry* e = &pack->entries[i];
+	if (offset >= e->size) return 0;
+	size_t size = e->size - offset < buf_size ? e->size - offset : buf_size;
+	if (fseek(pack->f, e->offset + offset, SEEK_SET)) return 0;
+	return fread_blk(buf, size, 1, pack->f) == 1 ? size : 0;
+}
+
+bool reportPackAppend(u32 transfer_id, CecMessageHeader* msg) {
+	ReportPack pack;
+	LightLock_Lock(&pack_lock);
+	bool ok = open_pack(transfer_id, &pack, true) && append(&pack, msg);
+	reportPackClose(&pack);
+	LightLock_Unlock(&pack_lock);
+	return ok;
+}
+
+static void add_title(u32* title_ids, int* num, int max, u32 title_id) {
+	for (int i = 0; i < *num; i++) {
+		if (title_ids[i] == title_id) return;
+	}
+	if (*num < max) title_ids[(*num)++] = title_id;
+}
+
+int reportPackTitles(u32 transfer_id, u32* title_ids, int max) {
+	char path[100];
+	struct stat st;
+	int num = 0;
+	LightLock_Lock(&pack_lock);
+	pack_path(path, transfer_id);
+	if (!stat(path, &st)) {
+		ReportPack pack;
+		memset(&pack, 0, sizeof(ReportPack));
+		FILE* f = fopen(path, "rb");
+		if (f && load(f, &pack)) {
+			for (int i = 0; i < pack.count && num < max; i++) add_title(title_ids, &num, max, pack.entries[i].title_id);
+			reportPackClose(&pack);
+		} else {
+			if (f) fclose(f);
+			num = -1;
+		}
+		goto cleanup;
+	}
+	// a directory from before the pack format stays as it is, its messages start with their header
+	snprintf(path, 100, "%s%lx", LOG_DIR, transfer_id);
+	DIR* d = opendir(path);
+	if (!d) {
+		num = -1;
+		goto cleanup;
+	}
+	struct dirent* p;
+	while ((p = readdir(d)) && num < max) {
+		char fname[100 + 20];
+		snprintf(fname, sizeof(fname), "%s/%s", path, p->d_name);
+		FILE* mf = fopen(fname, "rb");
+		if (!mf) continue;
+		CecMessageHeader msg;
+		if (fread_blk(&msg, sizeof(CecMessageHeader), 1, mf) == 1 && msg.magic == 0x6060) add_title(title_ids, &num, max, msg.title_id);
+		fclose(mf);
+	}
+	closedir(d);
+cleanup:
+	LightLock_Unlock(&pack_lock);
+	return num;
+}
+
+u32 reportPackSize(u32 transfer_id) {
+	char path[100];
+	struct stat st;
+	u32 size = 0;
+	pack_path(path, transfer_id);
+	if (!stat(path, &st)) size += st.st_size;
+	reportPackSummaryPath(path, transfer_id);
+	if (!stat(path, &st)) size += st.st_size;
+	return size;
+}
+
+void reportPackDelete(u32 transfer_id) {
+	char path[100];
+	LightLock_Lock(&pack_lock);
+	pack_path(path, transfer_id);
+	unlink(path);
+	reportPackSummaryPath(path, transfer_id);
+	unlink(path);
+	snprintf(path, 100, "%s%lx", LOG_DIR, transfer_id);
+	rmdir_r(path);
+	LightLock_Unlock(&pack_lock);
+}
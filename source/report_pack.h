@@ -0,0 +1,74 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+#include <stdio.h>
+#include "cecd.h"
+
+// All messages of one logged transfer live in a single file, log/<transfer id>.nrlp:
+// a table of offsets, followed by the message blobs in the order they arrived. Once a table is
+// full the next one goes after the last blob, and the full one points at it.
+// Transfers logged before this are still a directory with one file per message, those are
+// packed the first time they are touched
+#define REPORT_PACK_TABLE_SIZE 32
+// there is no limit on the messages of a transfer, this only stops a broken chain from looping
+#define REPORT_PACK_MAX_TABLES 64
+
+typedef struct {
+	CecMessageId message_id;
+	u32 title_id;
+	u32 offset;
+	u32 size;
+} ReportPackEntry;
+
+typedef struct {
+	u32 magic; // 0x504C524E "NRLP"
+	int version; // 1
+	u32 count;
+	u32 next; // offset of the next table, 0 for the last one
+	ReportPackEntry entries[REPORT_PACK_TABLE_SIZE];
+} ReportPackTable;
+
+typedef struct {
+	FILE* f;
+	u32 count;
+	ReportPackEntry* entries; // of all tables, in order
+	u32 tail; // offset of the last table
+	u32 tail_count;
+} ReportPack;
+
+// must be called before any other thread touches the log
+void reportPackInit(void);
+bool reportPackOpen(ReportPack* pack, u32 transfer_id);
+void reportPackClose(ReportPack* pack);
+// reads up to buf_size bytes of message i, returns how many were read
+size_t reportPackRead(ReportPack* pack, int i, void* buf, size_t buf_size);
+// same, but starting offset bytes into the message
+size_t reportPackReadAt(ReportPack* pack, int i, u32 offset, void* buf, size_t buf_size);
+// the decoded summary sidecar, log/<transfer id>.nrls. Appending to the pack invalidates it
+void reportPackSummaryPath(char* path, u32 transfer_id);
+// messages that are already in the pack are skipped
+bool reportPackAppend(u32 transfer_id, CecMessageHeader* msg);
+void reportPackDelete(u32 transfer_id);
+// the distinct games of the messages of a transfer, from the pack table or the message headers of
+// a directory from before the pack format, which is left alone. Returns -1 if there is neither
+int reportPackTitles(u32 transfer_id, u32* title_ids, int max);
+// bytes on the SD card for the pack and its sidecar
+u32 reportPackSize(u32 transfer_id);
@@ -0,0 +1,249 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report_prefetch.h"
+#include "utils.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+static LightLock prefetch_lock;
+// the jpeg decoder keeps global state, so only one decode at a time
+static LightLock jpeg_lock;
+static CondVar prefetch_cond;
+static Thread prefetch_thread = NULL;
+static bool prefetch_running = false;
+static ReportDecoded* cache[REPORT_PREFETCH_CACHE_SIZE];
+static u32 wanted[REPORT_PREFETCH_MAX_WANTED];
+static int num_wanted = 0;
+// what the worker is decoding right now, and what the scenes have taken out of the cache
+static u32 busy_id = 0;
+static u32 taken[REPORT_PREFETCH_CACHE_SIZE];
+static u32 use_clock = 0;
+
+void reportPrefetchInit(void) {
+	LightLock_Init(&prefetch_lock);
+	LightLock_Init(&jpeg_lock);
+	CondVar_Init(&prefetch_cond);
+}
+
+static void free_decoded(ReportDecoded* d) {
+	for (int i = 0; i < 12; i++) {
+		for (int j = 0; j < 4; j++) {
+			if (d->panes[i][j].tex) C2D_ImageDelete(&d->panes[i][j]);
+		}
+	}
+	freeReportMessages(&d->msgs);
+	free(d);
+}
+
+static bool is_wanted(u32 transfer_id) {
+	for (int i = 0; i < num_wanted; i++) {
+		if (wanted[i] == transfer_id) return true;
+	}
+	return false;
+}
+
+static bool is_taken(u32 transfer_id) {
+	for (int i = 0; i < REPORT_PREFETCH_CACHE_SIZE; i++) {
+		if (taken[i] == transfer_id) return true;
+	}
+	return false;
+}
+
+static int find_cached(u32 transfer_id) {
+	for (int i = 0; i < REPORT_PREFETCH_CACHE_SIZE; i++) {
+		if (cache[i] && cache[i]->transfer_id == transfer_id) return i;
+	}
+	return -1;
+}
+
+static bool cancelled(u32 transfer_id) {
+	LightLock_Lock(&prefetch_lock);
+	bool res = !prefetch_running || !is_wanted(transfer_id);
+	LightLock_Unlock(&prefetch_lock);
+	return res;
+}
+
+static ReportDecoded* decode(u32 transfer_id, bool can_cancel) {
+	ReportDecoded* d = malloc(sizeof(ReportDecoded));
+	if (!d) return NULL;
+	memset(d, 0, sizeof(ReportDecoded));
+	d->transfer_id = transfer_id;
+	if (!loadReportMessages(&d->msgs, transfer_id)) {
+		free_decoded(d);
+		return NULL;
+	}
+	for (int i = 0; i < d->msgs.count; i++) {
+		ReportMessagesEntry* entry = &d->msgs.entries[i];
+		if (entry->title_id != TITLE_LETTER_BOX || !entry->data) continue;
+		// the jpegs are the expensive part, so we check in between if the cursor moved on
+		if (can_cancel && cancelled(transfer_id)) {
+			free_decoded(d);
+			return NULL;
+		}
+		u8* entry_data = entry->data;
+		LightLock_Lock(&jpeg_lock);
+		for (int j = 0; j < 4; j++) {
+			u32 size = *((u32*)entry_data);
+			entry_data += 4;
+			if (size < 5000) { // protective measure
+				if (!loadJpeg(&d->panes[i][j], entry_data, size)) {
+					d->panes[i][j].tex = 0;
+				}
+			}
+			entry_data += size;
+			if (size % 4) entry_data += 4 - (size % 4);
+		}
+		LightLock_Unlock(&jpeg_lock);
+	}
+	return d;
+}
+
+// has to be called with the lock held
+static void cache_insert(ReportDecoded* d) {
+	d->last_used = ++use_clock;
+	int slot = 0;
+	for (int i = 0; i < REPORT_PREFETCH_CACHE_SIZE; i++) {
+		if (!cache[i]) {
+			slot = i;
+			break;
+		}
+		if (cache[i]->last_used < cache[slot]->last_used) slot = i;
+	}
+	if (cache[slot]) free_decoded(cache[slot]);
+	cache[slot] = d;
+}
+
+static void prefetch_worker(void* p) {
+	LightLock_Lock(&prefetch_lock);
+	while (prefetch_running) {
+		u32 transfer_id = 0;
+		for (int i = 0; i < num_wanted; i++) {
+			if (find_cached(wanted[i]) < 0 && !is_taken(wanted[i])) {
+				transfer_id = wanted[i];
+				break;
+			}
+		}
+		if (!transfer_id) {
+			CondVar_Wait(&prefetch_cond, &prefetch_lock);
+			continue;
+		}
+		busy_id = transfer_id;
+		LightLock_Unlock(&prefetch_lock);
+
+		ReportDecoded* d = decode(transfer_id, true);
+
+		LightLock_Lock(&prefetch_lock);
+		busy_id = 0;
+		if (d && prefetch_running && is_wanted(transfer_id)) {
+			cache_insert(d);
+		} else if (d) {
+			free_decoded(d);
+		} else {
+			DEBUG_PRINTF("Prefetch of %lx cancelled or failed\n", transfer_id);
+		}
+		CondVar_Broadcast(&prefetch_cond);
+	}
+	LightLock_Unlock(&prefetch_lock);
+}
+
+void reportPrefetchStart(void) {
+	if (prefetch_thread) return;
+	num_wanted = 0;
+	prefetch_running = true;
+	prefetch_thread = threadCreate(prefetch_worker, NULL, 16*1024, main_thread_prio()+1, -2, false);
+	if (!prefetch_thread) prefetch_running = false;
+}
+
+void reportPrefetchStop(void) {
+	if (!prefetch_thread) return;
+	LightLock_Lock(&prefetch_lock);
+	prefetch_running = false;
+	num_wanted = 0;
+	CondVar_Broadcast(&prefetch_cond);
+	LightLock_Unlock(&prefetch_lock);
+	threadJoin(prefetch_thread, U64_MAX);
+	threadFree(prefetch_thread);
+	prefetch_thread = NULL;
+	for (int i = 0; i < REPORT_PREFETCH_CACHE_SIZE; i++) {
+		if (cache[i]) free_decoded(cache[i]);
+		cache[i] = NULL;
+	}
+}
+
+void reportPrefetchWant(const u32* transfer_ids, int num) {
+	if (!prefetch_thread) return;
+	if (num > REPORT_PREFETCH_MAX_WANTED) num = REPORT_PREFETCH_MAX_WANTED;
+	LightLock_Lock(&prefetch_lock);
+	memcpy(wanted, transfer_ids, num * sizeof(u32));
+	num_wanted = num;
+	CondVar_Broadcast(&prefetch_cond);
+	LightLock_Unlock(&prefetch_lock);
+}
+
+static void untake(u32 transfer_id) {
+	for (int i = 0; i < REPORT_PREFETCH_CACHE_SIZE; i++) {
+		if (taken[i] == transfer_id) {
+			taken[i] = 0;
+			break;
+		}
+	}
+}
+
+ReportDecoded* reportPrefetchTake(u32 transfer_id) {
+	LightLock_Lock(&prefetch_lock);
+	// no point in decoding it twice if the worker is already on it
+	while (prefetch_running && busy_id == transfer_id) {
+		CondVar_Wait(&prefetch_cond, &prefetch_lock);
+	}
+	ReportDecoded* d = NULL;
+	int i = find_cached(transfer_id);
+	if (i >= 0) {
+		d = cache[i];
+		cache[i] = NULL;
+	}
+	for (int j = 0; j < REPORT_PREFETCH_CACHE_SIZE; j++) {
+		if (!taken[j]) {
+			taken[j] = transfer_id;
+			break;
+		}
+	}
+	LightLock_Unlock(&prefetch_lock);
+	if (!d) d = decode(transfer_id, false);
+	if (!d) {
+		LightLock_Lock(&prefetch_lock);
+		untake(transfer_id);
+		LightLock_Unlock(&prefetch_lock);
+	}
+	return d;
+}
+
+void reportPrefetchGiveBack(ReportDecoded* d) {
+	LightLock_Lock(&prefetch_lock);
+	if (d) {
+		untake(d->transfer_id);
+		// going back to the list, chances are it gets opened again
+		if (prefetch_running) {
+			cache_insert(d);
+			d = NULL;
+		}
+	}
+	LightLock_Unlock(&prefetch_lock);
+	if (d) free_decoded(d);
+}
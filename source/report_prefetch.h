@@ -0,0 +1,46 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+#include <citro2d.h>
+#include "report.h"
+
+// While the report list is open, a worker decodes the entries around the cursor ahead of time,
+// so that opening them doesn't have to wait on the SD card and the jpeg decoder
+#define REPORT_PREFETCH_CACHE_SIZE 4
+#define REPORT_PREFETCH_MAX_WANTED 3
+
+typedef struct {
+	u32 transfer_id;
+	u32 last_used;
+	ReportMessages msgs;
+	// letter box panes, per message
+	C2D_Image panes[12][4];
+} ReportDecoded;
+
+void reportPrefetchInit(void);
+void reportPrefetchStart(void);
+// stops the worker and drops everything cached
+void reportPrefetchStop(void);
+// the first transfer is the most important one, anything not in the list is cancelled
+void reportPrefetchWant(const u32* transfer_ids, int num);
+// returns the decoded transfer, decoding it right away if it isn't cached. Hand it back when done
+ReportDecoded* reportPrefetchTake(u32 transfer_id);
+void reportPrefetchGiveBack(ReportDecoded* d);
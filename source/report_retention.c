@@ -0,0 +1,235 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report_retention.h"
+#include "report_index.h"
+#include "report_pack.h"
+#include "config.h"
+#include "utils.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+// a pass re-checks everything every now and then, even if nobody kicked us
+#define RETENTION_IDLE_NS (5*60*1000000000LL)
+// time between two deletions, so that we never hog the SD card
+#define RETENTION_STEP_NS (50*1000000LL)
+#define RETENTION_LOCK_RETRY_NS (200*1000000LL)
+
+typedef struct {
+	u32 transfer_id;
+	u32 bytes;
+} RetentionSize;
+
+static LightLock retention_lock;
+static LightEvent retention_event;
+static Thread retention_thread = NULL;
+static bool retention_running = false;
+// sizes in index order, oldest first. Only the retention thread touches these
+static RetentionSize* sizes = NULL;
+static int num_sizes = 0;
+// what the settings get to see, guarded by retention_lock
+static u32 usage_entries = 0;
+static u64 usage_bytes = 0;
+static bool usage_scanned = false;
+static u32 touched[REPORT_RETENTION_MAX_TOUCHED];
+static int num_touched = 0;
+static bool touched_overflow = false;
+
+// the index lock is shared with the exchange, so we never wait on it for long
+static bool lock_index(void) {
+	while (retention_running) {
+		if (reportIndexTryLock()) return true;
+		svcSleepThread(RETENTION_LOCK_RETRY_NS);
+	}
+	return false;
+}
+
+static void publish_usage(u64 bytes, bool scanned) {
+	LightLock_Lock(&retention_lock);
+	usage_entries = num_sizes;
+	usage_bytes = bytes;
+	usage_scanned = scanned;
+	LightLock_Unlock(&retention_lock);
+}
+
+// brings the sizes in line with the index, only looking at transfers that are new or grew
+static bool refresh_sizes(u64* bytes) {
+	if (!lock_index()) return false;
+	ReportList* list = reportIndexGet();
+	int num = list ? list->header.cur_size : 0;
+	u32* ids = num ? malloc(num * sizeof(u32)) : NULL;
+	if (num && !ids) {
+		reportIndexUnlock();
+		return false;
+	}
+	for (int i = 0; i < num; i++) ids[i] = list->entries[i].transfer_id;
+	reportIndexUnlock();
+
+	LightLock_Lock(&retention_lock);
+	u32 my_touched[REPORT_RETENTION_MAX_TOUCHED];
+	int my_num_touched = num_touched;
+	bool overflow = touched_overflow;
+	memcpy(my_touched, touched, num_touched * sizeof(u32));
+	num_touched = 0;
+	touched_overflow = false;
+	LightLock_Unlock(&retention_lock);
+
+	RetentionSize* new_sizes = num ? malloc(num * sizeof(RetentionSize)) : NULL;
+	if (num && !new_sizes) {
+		free(ids);
+		return false;
+	}
+	*bytes = 0;
+	// both are in index order and the index only ever loses old entries and gains new ones,
+	// so a single walk over the old sizes is enough
+	int j = 0;
+	for (int i = 0; i < num && retention_running; i++) {
+		while (j < num_sizes && sizes[j].transfer_id != ids[i]) {
+			bool further = false;
+			for (int k = j + 1; k < num_sizes; k++) {
+				if (sizes[k].transfer_id == ids[i]) {
+					further = true;
+					break;
+				}
+			}
+			if (!further) break;
+			j++;
+		}
+		new_sizes[i].transfer_id = ids[i];
+		bool grew = overflow;
+		for (int k = 0; k < my_num_touched; k++) {
+			if (my_touched[k] == ids[i]) grew = true;
+		}
+		if (!grew && j < num_sizes && sizes[j].transfer_id == ids[i]) {
+			new_sizes[i].bytes = sizes[j++].bytes;
+		} else {
+			new_sizes[i].bytes = reportPackSize(ids[i]);
+		}
+		*bytes += new_sizes[i].bytes;
+	}
+	free(ids);
+	if (!retention_running) {
+		if (new_sizes) free(new_sizes);
+		return false;
+	}
+	if (sizes) free(sizes);
+	sizes = new_sizes;
+	num_sizes = num;
+	return true;
+}
+
+static void enforce_budget(u64 bytes) {
+	u32 budget_entries = config.log_budget_entries;
+	u64 budget_bytes = (u64)config.log_budget_mb * 1024 * 1024;
+	int first = 0;
+	while (retention_running && first < num_sizes && ((u32)(num_sizes - first) > budget_entries || bytes > budget_bytes)) {
+		u32 transfer_id = sizes[first].transfer_id;
+		if (!lock_index()) break;
+		// the files go while we still hold the lock. A log batch appends under it too, so letting go
+		// in between would let a late message for this transfer land in a pack we are about to delete,
+		// or recreate one next to an index that no longer knows it. It's a single transfer per step
+		reportIndexRemove(&transfer_id, 1);
+		reportPackDelete(transfer_id);
+		reportIndexUnlock();
+		bytes -= sizes[first].bytes;
+		first++;
+		DEBUG_PRINTF("Retention: removed %lx\n", transfer_id);
+		LightLock_Lock(&retention_lock);
+		usage_entries = num_sizes - first;
+		usage_bytes = bytes;
+		LightLock_Unlock(&retention_lock);
+		svcSleepThread(RETENTION_STEP_NS);
+	}
+	if (first) {
+		num_sizes -= first;
+		memmove(sizes, &sizes[first], num_sizes * sizeof(RetentionSize));
+		// the removals went into the journal, which may want folding by now
+		if (lock_index()) {
+			reportIndexCompact(false);
+			reportIndexUnlock();
+		}
+	}
+}
+
+static void retention_worker(void* p) {
+	while (retention_running) {
+		u64 bytes;
+		if (refresh_sizes(&bytes)) {
+			publish_usage(bytes, true);
+			enforce_budget(bytes);
+		}
+		LightEvent_WaitTimeout(&retention_event, RETENTION_IDLE_NS);
+	}
+}
+
+void reportRetentionInit(void) {
+	LightLock_Init(&retention_lock);
+	LightEvent_Init(&retention_event, RESET_ONESHOT);
+	retention_running = true;
+	retention_thread = threadCreate(retention_worker, NULL, 8*1024, main_thread_prio()+1, -2, false);
+	if (!retention_thread) retention_running = false;
+}
+
+void reportRetentionExit(void) {
+	if (!retention_thread) return;
+	retention_running = false;
+	LightEvent_Signal(&retention_event);
+	threadJoin(retention_thread, U64_MAX);
+	threadFree(retention_thread);
+	retention_thread = NULL;
+	if (sizes) free(sizes);
+	sizes = NULL;
+	num_sizes = 0;
+}
+
+void reportRetentionTouch(const u32* transfer_ids, int num) {
+	if (!retention_thread) return;
+	LightLock_Lock(&retention_lock);
+	for (int i = 0; i < num; i++) {
+		if (num_touched >= REPORT_RETENTION_MAX_TOUCHED) {
+			// too much at once, just look at everything again
+			touched_overflow = true;
+			break;
+		}
+		touched[num_touched++] = transfer_ids[i];
+	}
+	LightLock_Unlock(&retention_lock);
+	LightEvent_Signal(&retention_event);
+}
+
+void reportRetentionKick(void) {
+	if (!retention_thread) return;
+	LightEvent_Signal(&retention_event);
+}
+
+void reportRetentionGetUsage(ReportRetentionUsage* usage) {
+	usage->budget_entries = config.log_budget_entries;
+	usage->budget_bytes = (u64)config.log_budget_mb * 1024 * 1024;
+	if (!retention_thread) {
+		usage->num_entries = 0;
+		usage->bytes = 0;
+		usage->scanned = false;
+		return;
+	}
+	LightLock_Lock(&retention_lock);
+	usage->num_entries = usage_entries;
+	usage->bytes = usage_bytes;
+	usage->scanned = usage_scanned;
+	LightLock_Unlock(&retention_lock);
+}
@@ -0,0 +1,41 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+
+// Old transfers get deleted in the background until the log fits into the budget from the config.
+// The engine only ever takes the index lock to remove a single entry, and steps aside if somebody else holds it
+#define REPORT_RETENTION_MAX_TOUCHED 32
+
+typedef struct {
+	u32 num_entries;
+	u64 bytes;
+	u32 budget_entries;
+	u64 budget_bytes;
+	bool scanned; // false until the sizes of all transfers are known
+} ReportRetentionUsage;
+
+void reportRetentionInit(void);
+void reportRetentionExit(void);
+// these transfers grew, their size has to be looked at again
+void reportRetentionTouch(const u32* transfer_ids, int num);
+// the budget changed, or anything else that warrants a look
+void reportRetentionKick(void);
+void reportRetentionGetUsage(ReportRetentionUsage* usage);
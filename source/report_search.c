@@ -0,0 +1,328 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report_search.h"
+#include "report_index.h"
+#include "report_pack.h"
+#include "utils.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#define TITLES_PATH "sdmc:/config/netpass/log/index.nrlt"
+#define TITLES_TMP_PATH "sdmc:/config/netpass/log/index.nrlt.tmp"
+// records for transfers that are long gone pile up in the file, until we rewrite it
+#define MAX_RECORDS (REPORT_INDEX_MAX_ENTRIES * 2)
+#define HASH_SIZE (MAX_RECORDS * 2)
+
+typedef struct {
+	u32 transfer_id;
+	u8 num_titles;
+	bool has_titles;
+	bool has_name;
+	u32 title_ids[REPORT_SEARCH_MAX_TITLES];
+	char name[REPORT_SEARCH_NAME_LEN]; // normalized
+} SearchRecord;
+
+static SearchRecord* records = NULL;
+static int num_records = 0;
+static s16* hash = NULL;
+static int file_records = 0;
+static bool loaded = false;
+
+static void normalize(char* out, const char* in, size_t len) {
+	size_t j = 0;
+	for (size_t i = 0; in[i] && j < len - 1; i++) {
+		// only ascii gets folded, anything else has to match as is
+		if (in[i] == ' ') continue;
+		out[j++] = (u8)in[i] < 0x80 ? tolower((u8)in[i]) : in[i];
+	}
+	out[j] = '\0';
+}
+
+static u32 hash_of(u32 transfer_id) {
+	return (transfer_id * 2654435761u) % HASH_SIZE;
+}
+
+static SearchRecord* find(u32 transfer_id) {
+	for (u32 h = hash_of(transfer_id);; h = (h + 1) % HASH_SIZE) {
+		if (hash[h] < 0) return NULL;
+		if (records[hash[h]].transfer_id == transfer_id) return &records[hash[h]];
+	}
+}
+
+static void rehash(void) {
+	memset(hash, 0xFF, HASH_SIZE * sizeof(s16));
+	for (int i = 0; i < num_records; i++) {
+		u32 h = hash_of(records[i].transfer_id);
+		while (hash[h] >= 0) h = (h + 1) % HASH_SIZE;
+		hash[h] = i;
+	}
+}
+
+// drops the records of transfers that aren't in the index anymore
+static void prune(void) {
+	int j = 0;
+	for (int i = 0; i < num_records; i++) {
+		if (reportIndexFind(records[i].transfer_id)) records[j++] = records[i];
+	}
+	num_records = j;
+	rehash();
+}
+
+static SearchRecord* find_or_add(u32 transfer_id) {
+	SearchRecord* r = find(transfer_id);
+	if (r) return r;
+	if (num_records >= MAX_RECORDS) prune();
+	if (num_records >= MAX_RECORDS) return NULL;
+	r = &records[num_records];
+	memset(r, 0, sizeof(SearchRecord));
+	r->transfer_id = transfer_id;
+	u32 h = hash_of(transfer_id);
+	while (hash[h] >= 0) h = (h + 1) % HASH_SIZE;
+	hash[h] = num_records++;
+	return r;
+}
+
+static void set_titles(SearchRecord* r, const u32* title_ids, int num) {
+	r->num_titles = 0;
+	// a transfer repeats its games, so only the distinct ones count towards the limit
+	for (int i = 0; i < num && r->num_titles < REPORT_SEARCH_MAX_TITLES; i++) {
+		bool dup = false;
+		for (int j = 0; j < r->num_titles; j++) {
+			if (r->title_ids[j] == title_ids[i]) dup = true;
+		}
+		if (!dup) r->title_ids[r->num_titles++] = title_ids[i];
+	}
+	r->has_titles = true;
+}
+
+static void fill_record(ReportTitleRecord* tr, SearchRecord* r) {
+	memset(tr, 0, sizeof(ReportTitleRecord));
+	tr->magic = 0x5452;
+	tr->transfer_id = r->transfer_id;
+	tr->num_titles = r->num_titles;
+	memcpy(tr->title_ids, r->title_ids, r->num_titles * sizeof(u32));
+	tr->crc = crc16_ccitt(&tr->transfer_id, sizeof(ReportTitleRecord) - 4, 0);
+}
+
+static void rewrite_file(void) {
+	FILE* f = fopen(TITLES_TMP_PATH, "wb");
+	if (!f) return;
+	bool ok = true;
+	int num = 0;
+	ReportTitleRecord tr;
+	for (int i = 0; i < num_records && ok; i++) {
+		if (!records[i].has_titles) continue;
+		fill_record(&tr, &records[i]);
+		ok = fwrite_blk(&tr, sizeof(ReportTitleRecord), 1, f) == 1;
+		num++;
+	}
+	fclose(f);
+	if (!ok) {
+		unlink(TITLES_TMP_PATH);
+		return;
+	}
+	unlink(TITLES_PATH);
+	if (rename(TITLES_TMP_PATH, TITLES_PATH)) return;
+	file_records = num;
+}
+
+static bool load(void) {
+	if (loaded) return true;
+	ReportList* list = reportIndexGet();
+	if (!list) return false;
+	records = malloc(MAX_RECORDS * sizeof(SearchRecord));
+	hash = malloc(HASH_SIZE * sizeof(s16));
+	if (!records || !hash) {
+		if (records) free(records);
+		if (hash) free(hash);
+		records = NULL;
+		hash = NULL;
+		return false;
+	}
+	num_records = 0;
+	rehash();
+	file_records = 0;
+	FILE* f = fopen(TITLES_PATH, "rb");
+	if (f) {
+		ReportTitleRecord tr;
+		while (fread_blk(&tr, sizeof(ReportTitleRecord), 1, f) == 1) {
+			file_records++;
+			if (tr.magic != 0x5452 || tr.crc != crc16_ccitt(&tr.transfer_id, sizeof(ReportTitleRecord) - 4, 0)) continue;
+			if (!reportIndexFind(tr.transfer_id)) continue;
+			SearchRecord* r = find_or_add(tr.transfer_id);
+			if (r) set_titles(r, tr.title_ids, tr.num_titles);
+		}
+		fclose(f);
+	}
+	for (int i = 0; i < list->header.cur_size; i++) {
+		reportSearchSetEntry(&list->entries[i]);
+	}
+	loaded = true;
+	if (file_records > num_records + REPORT_INDEX_MAX_ENTRIES / 4) rewrite_file();
+	DEBUG_PRINTF("Search index: %d transfers, %d title records\n", num_records, file_records);
+	return true;
+}
+
+void reportSearchSetTitles(u32 transfer_id, const u32* title_ids, int num) {
+	if (!load()) return;
+	SearchRecord* r = find_or_add(transfer_id);
+	if (!r) return;
+	set_titles(r, title_ids, num);
+	ReportTitleRecord tr;
+	fill_record(&tr, r);
+	FILE* f = fopen(TITLES_PATH, "ab");
+	if (!f) return;
+	fwrite_blk(&tr, sizeof(ReportTitleRecord), 1, f);
+	fclose(f);
+	file_records++;
+}
+
+void reportSearchSetEntry(ReportListEntry* entry) {
+	// load() calls this for every entry, so don't recurse into it while loading
+	if (!records) {
+		if (!load()) return;
+	}
+	SearchRecord* r = find_or_add(entry->transfer_id);
+	if (!r) return;
+	r->has_name = false;
+	if (entry->mii.version != 3) return;
+	u8 mii_name[MII_UTF8_NAME_LEN];
+	get_mii_name(mii_name, &entry->mii);
+	normalize(r->name, (char*)mii_name, sizeof(r->name));
+	r->has_name = true;
+}
+
+void reportSearchBackfill(const bool* running) {
+	int done = 0;
+	while (*running) {
+		reportIndexLock();
+		ReportList* list = reportIndexGet();
+		u32 transfer_id = 0;
+		if (list && load()) {
+			for (int i = 0; i < list->header.cur_size; i++) {
+				SearchRecord* r = find(list->entries[i].transfer_id);
+				if (!r || !r->has_titles) {
+					transfer_id = list->entries[i].transfer_id;
+					break;
+				}
+			}
+		}
+		reportIndexUnlock();
+		if (!transfer_id) break;
+
+		// only the table at the start of the pack is read, or the message headers of an old
+		// log directory. Those get packed when they are opened, not here
+		u32 title_ids[REPORT_SEARCH_MAX_TITLES];
+		int num = reportPackTitles(transfer_id, title_ids, REPORT_SEARCH_MAX_TITLES);
+		if (num < 0) num = 0;
+		reportIndexLock();
+		// an empty record still marks it as done, so that we don't try again every time
+		reportSearchSetTitles(transfer_id, title_ids, num);
+		reportIndexUnlock();
+		done++;
+	}
+	if (done) DEBUG_PRINTF("Search index: backfilled %d transfers\n", done);
+}
+
+static bool matches(const ReportFilter* filter, ReportListEntry* entry, SearchRecord* r) {
+	switch (filter->type) {
+		case REPORT_FILTER_TITLE:
+			if (!r || !r->has_titles) return false;
+			for (int i = 0; i < r->num_titles; i++) {
+				if (r->title_ids[i] == filter->title_id) return true;
+			}
+			return false;
+		case REPORT_FILTER_DAY:
+			return report_day(&entry->received) == filter->day;
+		case REPORT_FILTER_NAME: {
+			if (!r || !r->has_name) return false;
+			char needle[REPORT_SEARCH_NAME_LEN];
+			normalize(needle, filter->name, sizeof(needle));
+			return strstr(r->name, needle) != NULL;
+		}
+		default:
+			return true;
+	}
+}
+
+int reportSearchQuery(const ReportFilter* filter, u32* transfer_ids, int max) {
+	int num = 0;
+	reportIndexLock();
+	ReportList* list = reportIndexGet();
+	if (list && load()) {
+		for (int i = 0; i < list->header.cur_size && num < max; i++) {
+			ReportListEntry* entry = &list->entries[i];
+			if (matches(filter, entry, find(entry->transfer_id))) transfer_ids[num++] = entry->transfer_id;
+		}
+	}
+	reportIndexUnlock();
+	return num;
+}
+
+int reportSearchTitleList(u32* title_ids, int max) {
+	int num = 0;
+	reportIndexLock();
+	ReportList* list = reportIndexGet();
+	if (list && load()) {
+		for (int i = 0; i < list->header.cur_size; i++) {
+			SearchRecord* r = find(list->entries[i].transfer_id);
+			if (!r) continue;
+			for (int j = 0; j < r->num_titles; j++) {
+				bool found = false;
+				for (int k = 0; k < num; k++) {
+					if (title_ids[k] == r->title_ids[j]) {
+						found = true;
+						break;
+					}
+				}
+				if (!found && num < max) title_ids[num++] = r->title_ids[j];
+			}
+		}
+	}
+	reportIndexUnlock();
+	return num;
+}
+
+int reportSearchDayList(u32* days, int max) {
+	int num = 0;
+	reportIndexLock();
+	ReportList* list = reportIndexGet();
+	if (list) {
+		// the index is in the order the passes came in, so each day is mostly a single run
+		for (int i = list->header.cur_size - 1; i >= 0 && num < max; i--) {
+			u32 day = report_day(&list->entries[i].received);
+			if (num && days[num - 1] == day) continue;
+			// unless the clock got changed at some point
+			bool found = false;
+			for (int j = 0; j < num; j++) {
+				if (days[j] == day) {
+					found = true;
+					break;
+				}
+			}
+			if (!found) days[num++] = day;
+		}
+	}
+	reportIndexUnlock();
+	return num;
+}
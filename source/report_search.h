@@ -0,0 +1,72 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+#include "report.h"
+
+// Secondary indexes over the report log, so that passes can be found by game, Mii name or day
+// without touching the messages. The games of each transfer are kept in index.nrlt, names and
+// days come straight from the report index. Everything here runs under the report index lock.
+// Queries walk the index with a hash lookup per entry rather than keeping per game and per day
+// lists: at REPORT_INDEX_MAX_ENTRIES that is a few thousand compares in memory, and the name
+// search is a substring match that has to look at every name anyway
+
+#define REPORT_SEARCH_MAX_TITLES 12
+#define REPORT_SEARCH_NAME_LEN MII_UTF8_NAME_LEN
+
+typedef enum {
+	REPORT_FILTER_NONE = 0,
+	REPORT_FILTER_TITLE,
+	REPORT_FILTER_DAY,
+	REPORT_FILTER_NAME,
+	NUM_REPORT_FILTERS,
+} ReportFilterType;
+
+typedef struct {
+	ReportFilterType type;
+	u32 title_id;
+	u32 day; // yyyymmdd
+	char name[REPORT_SEARCH_NAME_LEN]; // matches anywhere in the Mii name, case insensitive
+} ReportFilter;
+
+typedef struct {
+	u16 magic; // 0x5452 "RT"
+	u16 crc; // crc16 over the rest
+	u32 transfer_id;
+	u32 num_titles;
+	u32 title_ids[REPORT_SEARCH_MAX_TITLES];
+} ReportTitleRecord;
+
+static inline u32 report_day(CecTimestamp* t) {
+	return t->year * 10000 + t->month * 100 + t->day;
+}
+
+// called at log time with the lock held
+void reportSearchSetTitles(u32 transfer_id, const u32* title_ids, int num);
+void reportSearchSetEntry(ReportListEntry* entry);
+// fills in the games of transfers logged before the title index existed, from the pack headers.
+// Stops early once running goes false
+void reportSearchBackfill(const bool* running);
+
+// transfer ids matching the filter, oldest first
+int reportSearchQuery(const ReportFilter* filter, u32* transfer_ids, int max);
+// all games and days that show up in the log, for stepping through filters
+int reportSearchTitleList(u32* title_ids, int max);
+int reportSearchDayList(u32* days, int max);
@@ -52,7 +52,9 @@ Scene* processScene(Scene* scene);
 #include "scenes/about.h"
 #include "scenes/back_alley.h"
 #include "scenes/bad_os_version.h"
+#include "scenes/cecd_stats_scene.h"
 #include "scenes/error.h"
+#include "scenes/exchange_stats_scene.h"
 #include "scenes/home.h"
 #include "scenes/info.h"
 #include "scenes/integration_scene.h"
@@ -19,6 +19,8 @@
 #include "back_alley.h"
 #include "../utils.h"
 #include "../api.h"
+#include "../pending.h"
+#include "../cecd_worker.h"
 #include <stdlib.h>
 #include <time.h>
 #define N(x) scenes_back_alley_namespace_##x
@@ -40,48 +42,34 @@ typedef struct {
 	bool show_games;
 } N(DataStruct);
 
-PlayCoins* N(play_coins);
 u32 N(buy_title_id);
 
 SceneResult N(buy_pass)(Scene* sc, int i) {
 	N(buy_title_id) = _data->title_ids[i];
-	N(play_coins) = malloc(sizeof(PlayCoins));
-	if (!N(play_coins)) {
-		return scene_continue;
-	}
-	memcpy(N(play_coins), _data->play_coins, sizeof(PlayCoins));
 
 	Scene* scene = getLoadingScene(0, lambda(void, (void) {
-		char url[80];
-		snprintf(url, 80, "%s/pass/title_id/%lx", BASE_URL, N(buy_title_id));
-		Result res = httpRequest("PUT", url, 0, 0, 0, 0, 0);
-		if (R_FAILED(res)) {
-			if (res == -404) {
-				printf("ERROR: No fitting pass found!");
-				free(N(play_coins));
-				return;
-			}
-			goto error;
+		// the play coins are only taken once the server confirmed the purchase
+		PendingRecord r;
+		pendingInitRecord(&r, PENDING_PASS_PURCHASE, N(buy_title_id));
+		Result res = pendingSubmit(&r);
+		if (res == PENDING_QUEUED) {
+			printf("Offline, buying the pass once we are back\n");
+			return;
 		}
-		N(play_coins)->total_coins -= config.price;
-		config.price += 2;
-		configWrite();
-		if (config.price > 2) {
-			Handle handle = 0;
-			res = FSUSER_OpenFile(&handle, sharedextdata_b, fsMakePath(PATH_ASCII, "/gamecoin.dat"), FS_OPEN_WRITE, 0);
-			if (R_FAILED(res)) goto error;
-			u32 tmpval=0;
-			res = FSFILE_Write(handle, &tmpval, 0, N(play_coins), sizeof(PlayCoins), FS_WRITE_FLUSH);
-			FSFILE_Close(handle);
-			if (R_FAILED(res)) goto error;
-			free(N(play_coins));
+		if (R_FAILED(res)) return;
+		// only the title we bought the pass for has anything new. We are on the loading thread,
+		// so waiting for a running exchange to finish is fine
+		res = cecdExchangeLocked(lambda(Result, (void* p) {
+			return downloadTitleInbox(N(buy_title_id));
+		}), NULL);
+		if (res == DOWNLOAD_INBOX_INSERT_FAILED) {
+			// another download won't bring these back, they are in the log though
+			printf("ERROR: got the pass, but some of it didn't make it into the inbox\n");
+		} else if (R_FAILED(res)) {
+			// the slot never reached us, so a full exchange can still fetch it
+			printf("ERROR: failed fetching the pass: %ld, trying again with a full exchange\n", res);
+			triggerDownloadInboxes();
 		}
-		triggerDownloadInboxes();
-		return;
-	error:
-		_e(res);
-		printf("ERROR: failed processing pass: %lx\n", res);
-		free(N(play_coins));
 	}));
 	scene->pop_scene = sc->pop_scene;
 	sc->next_scene = scene;
@@ -0,0 +1,125 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cecd_stats_scene.h"
+#include "../cecd_stats.h"
+#include <stdlib.h>
+#define N(x) scenes_cecd_stats_namespace_##x
+#define _data ((N(DataStruct)*)sc->d)
+#define NUM_ROWS 10
+
+typedef struct {
+	C2D_TextBuf g_staticBuf;
+	C2D_TextBuf g_rowBuf;
+	C2D_Text g_title;
+	C2D_Text g_columns;
+	C2D_Text g_empty;
+	C2D_Text g_controls;
+	C2D_Text g_back;
+	C2D_Text g_names[NUM_ROWS];
+	C2D_Text g_values[NUM_ROWS];
+	int num_rows;
+} N(DataStruct);
+
+void N(load_rows)(Scene* sc) {
+	C2D_TextBufClear(_data->g_rowBuf);
+	CecdStatsEntry* entries = malloc(sizeof(CecdStatsEntry) * CECD_STATS_MAX_ENTRIES);
+	_data->num_rows = 0;
+	if (!entries) return;
+	int num = cecdStatsGet(entries, CECD_STATS_MAX_ENTRIES);
+	// only the calls we spent the most time in fit on screen, the SD dump has everything
+	_data->num_rows = num < NUM_ROWS ? num : NUM_ROWS;
+	for (int i = 0; i < _data->num_rows; i++) {
+		CecdStatsEntry* e = &entries[i];
+		char line[60];
+		snprintf(line, 40, "%s (%d)", cecdStatsCommandName(e->command), e->path);
+		C2D_TextParse(&_data->g_names[i], _data->g_rowBuf, line);
+		snprintf(line, 60, "%lu, %llu / %lu / %lu / %lu", e->count, e->total_us / e->count,
+			cecdStatsPercentileUs(e, 50), cecdStatsPercentileUs(e, 90), e->max_us);
+		C2D_TextParse(&_data->g_values[i], _data->g_rowBuf, line);
+	}
+	free(entries);
+}
+
+void N(init)(Scene* sc) {
+	sc->d = malloc(sizeof(N(DataStruct)));
+	if (!_data) return;
+	_data->g_staticBuf = C2D_TextBufNew(STR_CECD_STATS_LEN + STR_CECD_STATS_COLUMNS_LEN + STR_CECD_STATS_EMPTY_LEN + STR_CECD_STATS_CONTROLS_LEN + STR_B_GO_BACK_LEN);
+	_data->g_rowBuf = C2D_TextBufNew(NUM_ROWS*(40 + 60));
+	TextLangParse(&_data->g_title, _data->g_staticBuf, str_cecd_stats);
+	TextLangParse(&_data->g_columns, _data->g_staticBuf, str_cecd_stats_columns);
+	TextLangParse(&_data->g_empty, _data->g_staticBuf, str_cecd_stats_empty);
+	TextLangParse(&_data->g_controls, _data->g_staticBuf, str_cecd_stats_controls);
+	TextLangParse(&_data->g_back, _data->g_staticBuf, str_b_go_back);
+	N(load_rows)(sc);
+}
+
+void N(render)(Scene* sc) {
+	if (!_data) return;
+	u32 clr = C2D_Color32(0, 0, 0, 0xff);
+	C2D_DrawText(&_data->g_title, C2D_AlignLeft | C2D_WithColor, 10, 10, 0, 1, 1, clr);
+	if (_data->num_rows) {
+		C2D_DrawText(&_data->g_columns, C2D_AlignRight | C2D_WithColor, 390, 40, 0, 0.5, 0.5, clr);
+		for (int i = 0; i < _data->num_rows; i++) {
+			C2D_DrawText(&_data->g_names[i], C2D_AlignLeft | C2D_WithColor, 10, 56 + i*14, 0, 0.5, 0.5, clr);
+			C2D_DrawText(&_data->g_values[i], C2D_AlignRight | C2D_WithColor, 390, 56 + i*14, 0, 0.5, 0.5, clr);
+		}
+	} else {
+		C2D_DrawText(&_data->g_empty, C2D_AlignLeft | C2D_WithColor, 10, 40, 0, 0.5, 0.5, clr);
+	}
+	C2D_DrawText(&_data->g_back, C2D_AlignLeft | C2D_WithColor, 10, 222, 0, 0.5, 0.5, clr);
+	C2D_DrawText(&_data->g_controls, C2D_AlignRight | C2D_WithColor, 390, 222, 0, 0.5, 0.5, clr);
+}
+
+void N(exit)(Scene* sc) {
+	if (_data) {
+		C2D_TextBufDelete(_data->g_staticBuf);
+		C2D_TextBufDelete(_data->g_rowBuf);
+		free(_data);
+	}
+}
+
+SceneResult N(process)(Scene* sc) {
+	hidScanInput();
+	u32 kDown = hidKeysDown();
+	if (_data) {
+		if (kDown & KEY_X) {
+			cecdStatsReset();
+			N(load_rows)(sc);
+		}
+		if (kDown & KEY_Y) {
+			Result res = cecdStatsDumpToFile();
+			if (R_FAILED(res)) _e(res);
+		}
+	}
+	if (kDown & KEY_B) return scene_pop;
+	if (kDown & KEY_START) return scene_stop;
+	return scene_continue;
+}
+
+Scene* getCecdStatsScene(void) {
+	Scene* scene = malloc(sizeof(Scene));
+	if (!scene) return NULL;
+	scene->init = N(init);
+	scene->render = N(render);
+	scene->exit = N(exit);
+	scene->process = N(process);
+	scene->is_popup = false;
+	scene->need_free = true;
+	return scene;
+}
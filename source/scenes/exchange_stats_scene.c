@@ -0,0 +1,190 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "exchange_stats_scene.h"
+#include "../exchange_stats.h"
+#include "../cecd.h"
+#include <stdlib.h>
+#define N(x) scenes_exchange_stats_namespace_##x
+#define _data ((N(DataStruct)*)sc->d)
+#define NUM_ROWS (NUM_EXCHANGE_STAGES + 1)
+#define TEXT_BUF_LEN (STR_EXCHANGE_STATS_LEN + STR_EXCHANGE_STATS_SUMMARY_LEN + STR_EXCHANGE_STATS_COLUMNS_LEN + STR_EXCHANGE_STATS_EMPTY_LEN + STR_B_GO_BACK_LEN + STR_EXCHANGE_STATS_MORE_LEN + STR_EXCHANGE_STATS_IPC_LEN \
+	+ NUM_ROWS*(40 + 30) \
+	+ STR_EXCHANGE_STATS_CECD_LEN + STR_EXCHANGE_STATS_SPR_WAITS_LEN + 20 + STR_EXCHANGE_STATS_TRANSITION_COLUMNS_LEN + CECD_MAX_TRANSITION_STATS*(60 + 60))
+
+typedef struct {
+	C2D_TextBuf g_staticBuf;
+	C2D_Text g_title;
+	C2D_Text g_summary;
+	C2D_Text g_columns;
+	C2D_Text g_back;
+	C2D_Text g_more;
+	C2D_Text g_ipc;
+	C2D_Text g_names[NUM_ROWS];
+	C2D_Text g_values[NUM_ROWS];
+	bool has_stats;
+	// second page, what cecd itself is up to during this session
+	C2D_Text g_cecd_title;
+	C2D_Text g_spr_waits;
+	C2D_Text g_transition_columns;
+	C2D_Text g_transition_names[CECD_MAX_TRANSITION_STATS];
+	C2D_Text g_transition_values[CECD_MAX_TRANSITION_STATS];
+	int num_transitions;
+	int page;
+} N(DataStruct);
+
+static LanguageString* N(stage_names)[NUM_ROWS] = {
+	&str_exchange_stage_mbox_list,
+	&str_exchange_stage_metadata,
+	&str_exchange_stage_spr_enter,
+	&str_exchange_stage_upload,
+	&str_exchange_stage_finalise_send,
+	&str_exchange_stage_download,
+	&str_exchange_stage_add_slots,
+	&str_exchange_stage_log_write,
+	&str_exchange_stage_spr_exit,
+	&str_exchange_stage_total,
+};
+
+void N(parse_timing)(C2D_Text* text, C2D_TextBuf buf, ExchangeStageTiming* t) {
+	char line[40];
+	if (t->count) {
+		snprintf(line, 40, "%lu / %lu / %lu", t->min_ms, t->total_ms / t->count, t->max_ms);
+	} else {
+		snprintf(line, 40, "-");
+	}
+	C2D_TextParse(text, buf, line);
+}
+
+void N(init_cecd_page)(Scene* sc) {
+	TextLangParse(&_data->g_cecd_title, _data->g_staticBuf, str_exchange_stats_cecd);
+	TextLangParse(&_data->g_transition_columns, _data->g_staticBuf, str_exchange_stats_transition_columns);
+
+	// box access that had to wait for an exchange
+	CecdSprLockStats lock_stats;
+	cecdGetSprLockStats(&lock_stats);
+	char spr_text[STR_EXCHANGE_STATS_SPR_WAITS_LEN + 20];
+	snprintf(spr_text, sizeof(spr_text), _s(str_exchange_stats_spr_waits), (int)lock_stats.shared_waits, (int)lock_stats.shared_wait_max_ms);
+	C2D_TextFontParse(&_data->g_spr_waits, _font(str_exchange_stats_spr_waits), _data->g_staticBuf, spr_text);
+
+	CecdTransitionStats transitions[CECD_MAX_TRANSITION_STATS];
+	_data->num_transitions = cecdGetTransitionStats(transitions, CECD_MAX_TRANSITION_STATS);
+	for (int i = 0; i < _data->num_transitions; i++) {
+		CecdTransitionStats* t = &transitions[i];
+		char line[60];
+		snprintf(line, 60, "%s 0x%02X -> %d", t->start ? "start" : "stop", t->command, t->state);
+		C2D_TextParse(&_data->g_transition_names[i], _data->g_staticBuf, line);
+		if (t->count) {
+			snprintf(line, 60, "%lu / %lu / %lu, %lu", t->min_ms, t->total_ms / t->count, t->max_ms, t->timeouts);
+		} else {
+			snprintf(line, 60, "- / - / -, %lu", t->timeouts);
+		}
+		C2D_TextParse(&_data->g_transition_values[i], _data->g_staticBuf, line);
+	}
+}
+
+void N(init)(Scene* sc) {
+	sc->d = malloc(sizeof(N(DataStruct)));
+	if (!_data) return;
+	_data->page = 0;
+	_data->g_staticBuf = C2D_TextBufNew(TEXT_BUF_LEN);
+	TextLangParse(&_data->g_title, _data->g_staticBuf, str_exchange_stats);
+	TextLangParse(&_data->g_columns, _data->g_staticBuf, str_exchange_stats_columns);
+	TextLangParse(&_data->g_back, _data->g_staticBuf, str_b_go_back);
+	TextLangParse(&_data->g_more, _data->g_staticBuf, str_exchange_stats_more);
+	TextLangParse(&_data->g_ipc, _data->g_staticBuf, str_exchange_stats_ipc);
+	N(init_cecd_page)(sc);
+
+	ExchangeStatsSummary summary;
+	_data->has_stats = exchangeStatsLoadSummary(&summary) && summary.num_exchanges > 0;
+	if (!_data->has_stats) {
+		TextLangParse(&_data->g_summary, _data->g_staticBuf, str_exchange_stats_empty);
+		return;
+	}
+	char text[STR_EXCHANGE_STATS_SUMMARY_LEN + 20];
+	snprintf(text, sizeof(text), _s(str_exchange_stats_summary), summary.num_exchanges, summary.num_failed);
+	C2D_TextFontParse(&_data->g_summary, _font(str_exchange_stats_summary), _data->g_staticBuf, text);
+	for (int i = 0; i < NUM_ROWS; i++) {
+		TextLangParse(&_data->g_names[i], _data->g_staticBuf, *N(stage_names)[i]);
+		ExchangeStageTiming* t = i < NUM_EXCHANGE_STAGES ? &summary.stages[i] : &summary.total;
+		N(parse_timing)(&_data->g_values[i], _data->g_staticBuf, t);
+	}
+}
+
+void N(render)(Scene* sc) {
+	if (!_data) return;
+	u32 clr = C2D_Color32(0, 0, 0, 0xff);
+	if (_data->page == 1) {
+		C2D_DrawText(&_data->g_cecd_title, C2D_AlignLeft | C2D_WithColor, 10, 10, 0, 1, 1, clr);
+		C2D_DrawText(&_data->g_spr_waits, C2D_AlignLeft | C2D_WithColor, 10, 38, 0, 0.5, 0.5, clr);
+		C2D_DrawText(&_data->g_transition_columns, C2D_AlignRight | C2D_WithColor, 390, 54, 0, 0.5, 0.5, clr);
+		for (int i = 0; i < _data->num_transitions; i++) {
+			C2D_DrawText(&_data->g_transition_names[i], C2D_AlignLeft | C2D_WithColor, 20, 70 + i*14, 0, 0.5, 0.5, clr);
+			C2D_DrawText(&_data->g_transition_values[i], C2D_AlignRight | C2D_WithColor, 390, 70 + i*14, 0, 0.5, 0.5, clr);
+		}
+#ifdef CECD_STATS
+		C2D_DrawText(&_data->g_ipc, C2D_AlignRight | C2D_WithColor, 390, 208, 0, 0.5, 0.5, clr);
+#endif
+	} else {
+		C2D_DrawText(&_data->g_title, C2D_AlignLeft | C2D_WithColor, 10, 10, 0, 1, 1, clr);
+		C2D_DrawText(&_data->g_summary, C2D_AlignLeft | C2D_WithColor, 10, 38, 0, 0.5, 0.5, clr);
+		if (_data->has_stats) {
+			C2D_DrawText(&_data->g_columns, C2D_AlignRight | C2D_WithColor, 390, 54, 0, 0.5, 0.5, clr);
+			for (int i = 0; i < NUM_ROWS; i++) {
+				C2D_DrawText(&_data->g_names[i], C2D_AlignLeft | C2D_WithColor, 20, 70 + i*14, 0, 0.5, 0.5, clr);
+				C2D_DrawText(&_data->g_values[i], C2D_AlignRight | C2D_WithColor, 390, 70 + i*14, 0, 0.5, 0.5, clr);
+			}
+		}
+	}
+	C2D_DrawText(&_data->g_back, C2D_AlignLeft | C2D_WithColor, 10, 222, 0, 0.5, 0.5, clr);
+	C2D_DrawText(&_data->g_more, C2D_AlignRight | C2D_WithColor, 390, 222, 0, 0.5, 0.5, clr);
+}
+
+void N(exit)(Scene* sc) {
+	if (_data) {
+		C2D_TextBufDelete(_data->g_staticBuf);
+		free(_data);
+	}
+}
+
+SceneResult N(process)(Scene* sc) {
+	hidScanInput();
+	u32 kDown = hidKeysDown();
+	if (_data && kDown & KEY_X) _data->page = !_data->page;
+#ifdef CECD_STATS
+	if (_data && _data->page == 1 && kDown & KEY_Y) {
+		sc->next_scene = getCecdStatsScene();
+		return scene_push;
+	}
+#endif
+	if (kDown & KEY_B) return scene_pop;
+	if (kDown & KEY_START) return scene_stop;
+	return scene_continue;
+}
+
+Scene* getExchangeStatsScene(void) {
+	Scene* scene = malloc(sizeof(Scene));
+	if (!scene) return NULL;
+	scene->init = N(init);
+	scene->render = N(render);
+	scene->exit = N(exit);
+	scene->process = N(process);
+	scene->is_popup = false;
+	scene->need_free = true;
+	return scene;
+}
@@ -18,19 +18,48 @@
 
 #include "misc_settings.h"
 #include "about.h"
+#include "../report_retention.h"
 #define N(x) scenes_misc_settings_namespace_##x
 #define _data ((N(DataStruct)*)sc->d)
-#define TEXT_BUF_LEN (STR_SETTINGS_LEN + STR_DOWNLOAD_DATA_LEN + STR_DELETE_DATA_LEN + STR_UPDATE_PATCHES_LEN + STR_VIEW_RULES_LEN + STR_VIEW_PRIVACY_LEN + STR_BACK_LEN)
+#define TEXT_BUF_LEN (STR_SETTINGS_LEN + STR_DOWNLOAD_DATA_LEN + STR_DELETE_DATA_LEN + STR_UPDATE_PATCHES_LEN + STR_VIEW_RULES_LEN + STR_VIEW_PRIVACY_LEN + STR_EXCHANGE_STATS_LEN + STR_LOG_STORAGE_LEN + STR_BACK_LEN)
+#define USAGE_TEXT_LEN (STR_LOG_STORAGE_USAGE_LEN + STR_LOG_STORAGE_COUNTING_LEN + 30)
 
-#define NUM_ENTRIES 7
+#define NUM_ENTRIES 9
+#define ENTRY_HEIGHT 22
+#define LOG_STORAGE_ENTRY 7
+
+static const u32 N(log_budgets_mb)[] = { 8, 16, 32, 64, 128, 256, 512 };
+#define NUM_LOG_BUDGETS (sizeof(N(log_budgets_mb)) / sizeof(u32))
 
 typedef struct {
 	C2D_TextBuf g_staticBuf;
 	C2D_Text g_title;
 	C2D_Text g_entries[NUM_ENTRIES];
+	// the retention engine keeps counting in the background, so this gets refreshed
+	C2D_TextBuf g_usageBuf;
+	C2D_Text g_usage;
+	float log_storage_width;
+	int usage_refresh;
 	int cursor;
 } N(DataStruct);
 
+void N(update_usage)(Scene* sc) {
+	ReportRetentionUsage usage;
+	reportRetentionGetUsage(&usage);
+	char text[USAGE_TEXT_LEN];
+	int used_mb = (usage.bytes + 1024*1024 - 1) / (1024*1024);
+	int budget_mb = usage.budget_bytes / (1024*1024);
+	C2D_TextBufClear(_data->g_usageBuf);
+	if (usage.scanned) {
+		snprintf(text, USAGE_TEXT_LEN, _s(str_log_storage_usage), (int)usage.num_entries, used_mb, budget_mb);
+		C2D_TextFontParse(&_data->g_usage, _font(str_log_storage_usage), _data->g_usageBuf, text);
+	} else {
+		snprintf(text, USAGE_TEXT_LEN, _s(str_log_storage_counting), used_mb, budget_mb);
+		C2D_TextFontParse(&_data->g_usage, _font(str_log_storage_counting), _data->g_usageBuf, text);
+	}
+	_data->usage_refresh = 30;
+}
+
 static void downloadDataThread(void);
 
 void N(init)(Scene* sc) {
@@ -45,18 +74,24 @@ void N(init)(Scene* sc) {
 	TextLangParse(&_data->g_entries[3], _data->g_staticBuf, str_update_patches);
 	TextLangParse(&_data->g_entries[4], _data->g_staticBuf, str_view_privacy);
 	TextLangParse(&_data->g_entries[5], _data->g_staticBuf, str_view_rules);
-	TextLangParse(&_data->g_entries[6], _data->g_staticBuf, str_back);
+	TextLangParse(&_data->g_entries[6], _data->g_staticBuf, str_exchange_stats);
+	TextLangParse(&_data->g_entries[LOG_STORAGE_ENTRY], _data->g_staticBuf, str_log_storage);
+	TextLangParse(&_data->g_entries[8], _data->g_staticBuf, str_back);
+	get_text_dimensions(&_data->g_entries[LOG_STORAGE_ENTRY], 1, 1, &_data->log_storage_width, 0);
+	_data->g_usageBuf = C2D_TextBufNew(USAGE_TEXT_LEN);
+	N(update_usage)(sc);
 }
 
 void N(render)(Scene* sc) {
 	if (!_data) return;
 	C2D_DrawText(&_data->g_title, C2D_AlignLeft, 10, 10, 0, 1, 1);
 	for (int i = 0; i < NUM_ENTRIES; i++) {
-		C2D_DrawText(&_data->g_entries[i], C2D_AlignLeft, 30, 10 + (i+1)*25, 0, 1, 1);
+		C2D_DrawText(&_data->g_entries[i], C2D_AlignLeft, 30, 10 + (i+1)*ENTRY_HEIGHT, 0, 1, 1);
 	}
+	C2D_DrawText(&_data->g_usage, C2D_AlignLeft, 40 + _data->log_storage_width, 10 + (LOG_STORAGE_ENTRY+1)*ENTRY_HEIGHT + 8, 0, 0.6, 0.6);
 	u32 clr = C2D_Color32(0, 0, 0, 0xff);
 	int x = 10;
-	int y = 10 + (_data->cursor + 1)*25 + 5;
+	int y = 10 + (_data->cursor + 1)*ENTRY_HEIGHT + 5;
 	C2D_DrawTriangle(x, y, clr, x, y + 18, clr, x + 15, y + 9, clr, 0);
 	u32 blue = C2D_Color32(0x2B, 0xCF, 0xFF, 0xFF);
 	u32 pink = C2D_Color32(0xF5, 0xAB, 0xB9, 0xFF);
@@ -78,6 +113,7 @@ void N(render)(Scene* sc) {
 void N(exit)(Scene* sc) {
 	if (_data) {
 		C2D_TextBufDelete(_data->g_staticBuf);
+		C2D_TextBufDelete(_data->g_usageBuf);
 		free(_data);
 	}
 }
@@ -89,6 +125,24 @@ SceneResult N(process)(Scene* sc) {
 		_data->cursor += ((kDown & KEY_DOWN || kDown & KEY_CPAD_DOWN) && 1) - ((kDown & KEY_UP || kDown & KEY_CPAD_UP) && 1);
 		if (_data->cursor < 0) _data->cursor = NUM_ENTRIES - 1;
 		if (_data->cursor > NUM_ENTRIES - 1) _data->cursor = 0;
+		if (_data->cursor == LOG_STORAGE_ENTRY) {
+			int dir = ((kDown & KEY_RIGHT || kDown & KEY_CPAD_RIGHT) && 1) - ((kDown & KEY_LEFT || kDown & KEY_CPAD_LEFT) && 1);
+			if (dir) {
+				// step to the next preset from wherever the config file put us
+				int i = 0;
+				while (i < NUM_LOG_BUDGETS - 1 && N(log_budgets_mb)[i] < config.log_budget_mb) i++;
+				if (dir < 0 && N(log_budgets_mb)[i] >= config.log_budget_mb && i > 0) i--;
+				if (dir > 0 && N(log_budgets_mb)[i] <= config.log_budget_mb && i < NUM_LOG_BUDGETS - 1) i++;
+				u32 budget = N(log_budgets_mb)[i];
+				if (dir > 0 ? budget > config.log_budget_mb : budget < config.log_budget_mb) {
+					config.log_budget_mb = budget;
+					configWrite();
+					reportRetentionKick();
+					_data->usage_refresh = 0;
+				}
+			}
+		}
+		if (--_data->usage_refresh <= 0) N(update_usage)(sc);
 		if (kDown & KEY_A) {
 			if (_data->cursor == 0) {
 				// About
@@ -125,7 +179,12 @@ SceneResult N(process)(Scene* sc) {
 			if (_data->cursor == 5) {
 				open_url(RULES_URL);
 			}
-			if (_data->cursor == 6) return scene_pop;
+			if (_data->cursor == 6) {
+				// exchange statistics
+				sc->next_scene = getExchangeStatsScene();
+				return scene_push;
+			}
+			if (_data->cursor == 8) return scene_pop;
 		}
 	}
 	if (kDown & KEY_B) return scene_pop;
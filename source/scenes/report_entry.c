@@ -18,6 +18,9 @@
 
 #include "report_entry.h"
 #include "../report.h"
+#include "../report_prefetch.h"
+#include "../pending.h"
+#include "../cecd_worker.h"
 #include "../hmac_sha256/sha256.h"
 #include <stdlib.h>
 #include <malloc.h>
@@ -59,11 +62,16 @@ typedef struct {
 	u32 title_ids[12];
 	C2D_Text* g_game_names;
 	C2D_Text* g_mii_names;
+	// decoded by the prefetcher if we are lucky, msgs points into it
+	ReportDecoded* decoded;
 	ReportMessages* msgs;
 	int y_offset;
 	void* extra_data[12];
 	C2D_Text go_back;
 	C2D_Text source_name;
+	// game names we didn't know yet, fetched by the cecd worker while we show the title id
+	C2D_TextBuf g_nameBuf;
+	CecdJob* name_jobs[12];
 } N(DataStruct);
 
 char* N(send_msg);
@@ -102,8 +110,10 @@ SceneResult N(report)(Scene* sc) {
 			}
 			SHA256_HASH hash;
 			Sha256Calculate(&msg, 0x28, &hash);
-			ReportSendPayload* data = malloc(sizeof(ReportSendPayload));
-			if (!data) goto exit;
+			PendingRecord* r = malloc(sizeof(PendingRecord));
+			if (!r) goto exit;
+			pendingInitRecord(r, PENDING_REPORT, 0);
+			ReportSendPayload* data = &r->report;
 			
 			data->magic = 0x5053524e;
 			data->version = 1;
@@ -111,16 +121,11 @@ SceneResult N(report)(Scene* sc) {
 			memcpy(&data->hash, &hash, sizeof(SHA256_HASH));
 			memcpy(data->msg, N(send_msg), sizeof(data->msg));
 
-			char url[50];
-			snprintf(url, 50, "%s/report/new", BASE_URL);
-			res = httpRequest("POST", url, sizeof(ReportSendPayload), (u8*)data, 0, 0, 0);
-			free(data);
-			if (R_FAILED(res)) {
-				printf("Error sending report: %ld\n", res);
-				goto exit;
+			res = pendingSubmit(r);
+			free(r);
+			if (res == PENDING_QUEUED) {
+				printf("Offline, the report will be sent once we are back\n");
 			}
-
-			printf("report sent\n");
 		exit:
 			free(N(send_msg));
 		}));
@@ -138,26 +143,18 @@ void N(init)(Scene* sc) {
 	memset(sc->d, 0, sizeof(N(DataStruct)));
 	_data->entry = (ReportListEntry*)sc->data;
 
-	_data->msgs = malloc(sizeof(ReportMessages));
-	if (!_data->msgs) {
-		free(_data);
-		sc->d = NULL;
-		return;
-	}
-
-	if (!loadReportMessages(_data->msgs, _data->entry->transfer_id)) {
+	_data->decoded = reportPrefetchTake(_data->entry->transfer_id);
+	if (!_data->decoded) {
 		_e(-1);
-		freeReportMessages(_data->msgs);
-		free(_data->msgs);
 		free(_data);
 		sc->d = NULL;
 		return;
 	}
+	_data->msgs = &_data->decoded->msgs;
 
 	_data->g_game_names = malloc(sizeof(C2D_Text) * _data->msgs->count);
 	if (!_data->g_game_names) {
-		freeReportMessages(_data->msgs);
-		free(_data->msgs);
+		reportPrefetchGiveBack(_data->decoded);
 		free(_data);
 		sc->d = NULL;
 		return;
@@ -166,14 +163,14 @@ void N(init)(Scene* sc) {
 	_data->g_mii_names = malloc(sizeof(C2D_Text) * _data->msgs->count);
 	if (!_data->g_mii_names) {
 		free(_data->g_game_names);
-		freeReportMessages(_data->msgs);
-		free(_data->msgs);
+		reportPrefetchGiveBack(_data->decoded);
 		free(_data);
 		sc->d = NULL;
 		return;
 	}
 
 	_data->g_staticBuf = C2D_TextBufNew(300 * (_data->msgs->count + 1));
+	_data->g_nameBuf = C2D_TextBufNew(100 * _data->msgs->count);
 
 	// first create the heading
 	{
@@ -209,21 +206,15 @@ void N(init)(Scene* sc) {
 			char game_name[50];
 			snprintf(game_name, 50, "%08lx", entry->title_id);
 			C2D_TextParse(&_data->g_game_names[i], _data->g_staticBuf, game_name);
+			_data->name_jobs[i] = cecdQueueOpenAndRead(entry->title_id, CECMESSAGE_BOX_TITLE, 198);
 		}
 		switch (entry->title_id) {
 			case TITLE_LETTER_BOX: {
-				SETUP_EXDATA_INIT(u8, ExtraDataLetterbox);
-				for (int j = 0; j < 4; j++) {
-					u32 size = *((u32*)entry_data);
-					entry_data += 4;
-					if (size < 5000) { // protective measure
-						if (!loadJpeg(&ex_data->pane[j], entry_data, size)) {
-							ex_data->pane[j].tex = 0;
-						}
-					}
-					entry_data += size;
-					if (size % 4) entry_data += 4 - (size % 4);
-				}
+				// the jpegs are already decoded, and stay owned by the decoded transfer
+				_data->extra_data[i] = malloc(sizeof(N(ExtraDataLetterbox)));
+				if (!_data->extra_data[i]) break;
+				N(ExtraDataLetterbox)* ex_data = _data->extra_data[i];
+				memcpy(ex_data->pane, _data->decoded->panes[i], sizeof(ex_data->pane));
 				break;
 			}
 			case TITLE_MARIO_KART_7: {
@@ -326,29 +317,38 @@ void N(render)(Scene* sc) {
 void N(exit)(Scene* sc) {
 	if (_data) {
 		for (int i = 0; i < 12; i++) {
-			if (!_data->extra_data[i]) continue;
-			ReportMessagesEntry* entry = &_data->msgs->entries[i];
-			switch (entry->title_id) {
-				case TITLE_LETTER_BOX: {
-					N(ExtraDataLetterbox)* ex_data = _data->extra_data[i];
-					for (int j = 0; j < 4; j++) {
-						if (!ex_data->pane[j].tex) continue;
-						C2D_ImageDelete(&ex_data->pane[j]);
-					}
-				}
-			}
-			free(_data->extra_data[i]);
+			if (_data->extra_data[i]) free(_data->extra_data[i]);
+		}
+		for (int i = 0; i < 12; i++) {
+			cecdJobRelease(_data->name_jobs[i]);
 		}
 		C2D_TextBufDelete(_data->g_staticBuf);
+		C2D_TextBufDelete(_data->g_nameBuf);
 		free(_data->g_mii_names);
 		free(_data->g_game_names);
-		freeReportMessages(_data->msgs);
-		free(_data->msgs);
+		reportPrefetchGiveBack(_data->decoded);
 		free(_data);
 	}
 }
 
+void N(poll_names)(Scene* sc) {
+	for (int i = 0; i < _data->msgs->count; i++) {
+		CecdJob* job = _data->name_jobs[i];
+		if (!job || !cecdJobDone(job)) continue;
+		if (R_SUCCEEDED(job->res)) {
+			char game_name[100];
+			memset(game_name, 0, sizeof(game_name));
+			// SAFETY: utf16_to_utf8 does not write a zero terminator, so we memset above
+			utf16_to_utf8((u8*)game_name, (u16*)job->buf, sizeof(game_name) - 1);
+			if (game_name[0]) C2D_TextParse(&_data->g_game_names[i], _data->g_nameBuf, game_name);
+		}
+		cecdJobRelease(job);
+		_data->name_jobs[i] = NULL;
+	}
+}
+
 SceneResult N(process)(Scene* sc) {
+	if (_data) N(poll_names)(sc);
 	hidScanInput();
 	u32 kDown = hidKeysDown();
 	u32 kHeld = hidKeysHeld();
@@ -18,22 +18,247 @@
 
 #include "report_list.h"
 #include "../report.h"
+#include "../report_prefetch.h"
+#include "../report_index.h"
+#include "../report_search.h"
+#include "../report_import.h"
 #include <stdlib.h>
 #include <malloc.h>
 #define N(x) scenes_report_list_namespace_##x
 #define _data ((N(DataStruct)*)sc->d)
 
+// only the rows around the visible window get laid out, their text is recycled while scrolling
+#define ROW_HEIGHT 14
+#define VISIBLE_ROWS 17
+#define ROW_MARGIN 4
+#define NUM_ROW_SLOTS (VISIBLE_ROWS + 2*ROW_MARGIN)
+#define HEADER_HEIGHT 30
+#define FILTER_TEXT_LEN (STR_REPORT_FILTER_ALL_LEN + STR_REPORT_FILTER_TITLE_LEN + STR_REPORT_FILTER_DAY_LEN + STR_REPORT_FILTER_NAME_LEN + REPORT_SEARCH_NAME_LEN + 60)
+#define TEXT_BUF_LEN (FILTER_TEXT_LEN + STR_REPORT_FILTER_CONTROLS_LEN)
+
+typedef struct {
+	C2D_TextBuf buf;
+	C2D_Text text;
+	int row;
+} N(RowSlot);
+
 typedef struct {
-	C2D_TextBuf g_staticBuf;
 	ReportList* list;
-	C2D_Text* g_entries;
+	N(RowSlot) rows[NUM_ROW_SLOTS];
 	int cursor;
 	int offset;
+	int prefetch_cursor;
+	// the rows that pass the filter, as indices into list, newest first
+	int* order;
+	int num_rows;
+	ReportFilter filter;
+	// games or days the filter can step through
+	u32* filter_values;
+	int num_filter_values;
+	int filter_value;
+	C2D_TextBuf g_headerBuf;
+	C2D_Text g_filter;
+	C2D_Text g_controls;
+	// relayed passes still coming in from the background import
+	C2D_TextBuf g_importBuf;
+	C2D_Text g_import;
+	bool importing;
+	int import_refresh;
 } N(DataStruct);
 
+typedef struct {
+	u32 transfer_id;
+	int index;
+} N(IdIndex);
+
 char* N(send_msg);
 u32 N(send_transfer_id);
 
+ReportListEntry* N(row_entry)(Scene* sc, int row) {
+	return &_data->list->entries[_data->order[row]];
+}
+
+int N(first_row)(Scene* sc) {
+	int row = (_data->offset - 35) / ROW_HEIGHT - 1;
+	return row < 0 ? 0 : row;
+}
+
+void N(layout_row)(Scene* sc, int row) {
+	N(RowSlot)* slot = &_data->rows[row % NUM_ROW_SLOTS];
+	if (slot->row == row) return;
+	ReportListEntry* entry = N(row_entry)(sc, row);
+	u8 mii_name[MII_UTF8_NAME_LEN];
+	get_mii_name(mii_name, &entry->mii);
+	char render_entry[30 + MII_UTF8_NAME_LEN];
+	snprintf(render_entry, 30 + MII_UTF8_NAME_LEN, "%s  %04lu-%02d-%02d %02d:%02d:%02d", mii_name,
+		entry->received.year, entry->received.month, entry->received.day,
+		entry->received.hour, entry->received.minute, entry->received.second);
+	C2D_TextBufClear(slot->buf);
+	C2D_TextFontParse(&slot->text, getFontIndex(entry->mii.mii_options.char_set), slot->buf, render_entry);
+	slot->row = row;
+}
+
+void N(layout_window)(Scene* sc) {
+	int first = N(first_row)(sc) - ROW_MARGIN;
+	if (first < 0) first = 0;
+	for (int row = first; row < first + NUM_ROW_SLOTS && row < _data->num_rows; row++) {
+		N(layout_row)(sc, row);
+	}
+}
+
+void N(prefetch)(Scene* sc) {
+	if (_data->prefetch_cursor == _data->cursor) return;
+	_data->prefetch_cursor = _data->cursor;
+	// the selected one first, then the ones we are most likely to scroll to
+	int rows[REPORT_PREFETCH_MAX_WANTED] = { _data->cursor, _data->cursor + 1, _data->cursor - 1 };
+	u32 transfer_ids[REPORT_PREFETCH_MAX_WANTED];
+	int num = 0;
+	for (int i = 0; i < REPORT_PREFETCH_MAX_WANTED; i++) {
+		if (rows[i] < 0 || rows[i] >= _data->num_rows) continue;
+		transfer_ids[num++] = N(row_entry)(sc, rows[i])->transfer_id;
+	}
+	reportPrefetchWant(transfer_ids, num);
+}
+
+int N(compare_ids)(const void* a, const void* b) {
+	u32 ia = ((const N(IdIndex)*)a)->transfer_id;
+	u32 ib = ((const N(IdIndex)*)b)->transfer_id;
+	return ia < ib ? -1 : ia > ib;
+}
+
+void N(update_header)(Scene* sc) {
+	char text[FILTER_TEXT_LEN];
+	LanguageString* str = &str_report_filter_all;
+	switch (_data->filter.type) {
+		case REPORT_FILTER_TITLE: {
+			str = &str_report_filter_title;
+			char game_name[50];
+			snprintf(game_name, 50, "%08lx", _data->filter.title_id);
+			NetpassTitleData* title_data = getTitleData();
+			for (int i = 0; i < title_data->num_titles; i++) {
+				if (title_data->titles[i].title_id == _data->filter.title_id) {
+					snprintf(game_name, 50, "%s", title_data->titles[i].name);
+					break;
+				}
+			}
+			snprintf(text, FILTER_TEXT_LEN, _s(*str), game_name, _data->num_rows);
+			break;
+		}
+		case REPORT_FILTER_DAY: {
+			str = &str_report_filter_day;
+			u32 day = _data->filter.day;
+			snprintf(text, FILTER_TEXT_LEN, _s(*str), (int)(day / 10000), (int)(day / 100 % 100), (int)(day % 100), _data->num_rows);
+			break;
+		}
+		case REPORT_FILTER_NAME:
+			str = &str_report_filter_name;
+			snprintf(text, FILTER_TEXT_LEN, _s(*str), _data->filter.name, _data->num_rows);
+			break;
+		default:
+			snprintf(text, FILTER_TEXT_LEN, _s(*str), _data->num_rows);
+	}
+	C2D_TextBufClear(_data->g_headerBuf);
+	C2D_TextFontParse(&_data->g_filter, _font(*str), _data->g_headerBuf, text);
+	TextLangParse(&_data->g_controls, _data->g_headerBuf, str_report_filter_controls);
+}
+
+void N(apply_filter)(Scene* sc) {
+	int total = _data->list->header.cur_size;
+	_data->num_rows = 0;
+	if (_data->filter.type == REPORT_FILTER_NONE) {
+		// newest first
+		for (int i = total - 1; i >= 0; i--) _data->order[_data->num_rows++] = i;
+	} else {
+		// the search runs on the live index, which may have moved on since we copied the list
+		u32* ids = malloc(sizeof(u32) * total);
+		N(IdIndex)* lookup = malloc(sizeof(N(IdIndex)) * total);
+		if (ids && lookup) {
+			for (int i = 0; i < total; i++) {
+				lookup[i].transfer_id = _data->list->entries[i].transfer_id;
+				lookup[i].index = i;
+			}
+			qsort(lookup, total, sizeof(N(IdIndex)), N(compare_ids));
+			int num = reportSearchQuery(&_data->filter, ids, total);
+			for (int i = num - 1; i >= 0; i--) {
+				N(IdIndex) key = { .transfer_id = ids[i] };
+				N(IdIndex)* found = bsearch(&key, lookup, total, sizeof(N(IdIndex)), N(compare_ids));
+				if (found) _data->order[_data->num_rows++] = found->index;
+			}
+		}
+		if (ids) free(ids);
+		if (lookup) free(lookup);
+	}
+	_data->cursor = 0;
+	_data->offset = -2;
+	_data->prefetch_cursor = -1;
+	for (int i = 0; i < NUM_ROW_SLOTS; i++) _data->rows[i].row = -1;
+	N(update_header)(sc);
+}
+
+void N(load_filter_values)(Scene* sc) {
+	_data->num_filter_values = 0;
+	_data->filter_value = 0;
+	if (_data->filter.type == REPORT_FILTER_TITLE) {
+		_data->num_filter_values = reportSearchTitleList(_data->filter_values, REPORT_INDEX_MAX_ENTRIES);
+	} else if (_data->filter.type == REPORT_FILTER_DAY) {
+		_data->num_filter_values = reportSearchDayList(_data->filter_values, REPORT_INDEX_MAX_ENTRIES);
+	}
+}
+
+void N(select_filter_value)(Scene* sc) {
+	if (!_data->num_filter_values) return;
+	u32 value = _data->filter_values[_data->filter_value];
+	if (_data->filter.type == REPORT_FILTER_TITLE) _data->filter.title_id = value;
+	if (_data->filter.type == REPORT_FILTER_DAY) _data->filter.day = value;
+}
+
+void N(search_name)(Scene* sc) {
+	char name[REPORT_SEARCH_NAME_LEN];
+	memset(name, 0, sizeof(name));
+	SwkbdState swkbd;
+	swkbdInit(&swkbd, SWKBD_TYPE_NORMAL, 2, MII_UTF16_NAME_LEN);
+	swkbdSetHintText(&swkbd, _s(str_report_filter_search_hint));
+	swkbdSetButton(&swkbd, SWKBD_BUTTON_LEFT, _s(str_cancel), false);
+	swkbdSetButton(&swkbd, SWKBD_BUTTON_RIGHT, _s(str_submit), true);
+	swkbdSetFeatures(&swkbd, SWKBD_DARKEN_TOP_SCREEN);
+	swkbdSetValidation(&swkbd, SWKBD_NOTEMPTY_NOTBLANK, 0, 0);
+	if (swkbdInputText(&swkbd, name, sizeof(name)) != SWKBD_D1_CLICK1) return;
+	_data->filter.type = REPORT_FILTER_NAME;
+	memcpy(_data->filter.name, name, sizeof(name));
+	N(apply_filter)(sc);
+}
+
+// the list is a copy, so once the import is through we take a fresh one
+void N(reload)(Scene* sc) {
+	ReportList* list = loadReportList();
+	if (!list) return;
+	int* order = malloc(sizeof(int) * (list->header.cur_size ? list->header.cur_size : 1));
+	if (!order) {
+		free(list);
+		return;
+	}
+	free(_data->list);
+	free(_data->order);
+	_data->list = list;
+	_data->order = order;
+	N(apply_filter)(sc);
+}
+
+void N(update_import)(Scene* sc) {
+	ReportImportProgress progress;
+	reportImportGetProgress(&progress);
+	bool was_importing = _data->importing;
+	_data->importing = progress.running && progress.total;
+	if (_data->importing) {
+		char text[STR_REPORT_IMPORT_PROGRESS_LEN + 20];
+		snprintf(text, sizeof(text), _s(str_report_import_progress), progress.done, progress.total);
+		C2D_TextBufClear(_data->g_importBuf);
+		C2D_TextFontParse(&_data->g_import, _font(str_report_import_progress), _data->g_importBuf, text);
+	}
+	if (was_importing && !_data->importing) N(reload)(sc);
+	_data->import_refresh = 30;
+}
+
 void N(init)(Scene* sc) {
 	sc->d = malloc(sizeof(N(DataStruct)));
 	if (!_data) return;
@@ -47,27 +272,31 @@ void N(init)(Scene* sc) {
 		return;
 	}
 
-	_data->g_entries = malloc(sizeof(C2D_Text) * _data->list->header.cur_size);
-	if (!_data->g_entries) {
+	int total = _data->list->header.cur_size;
+	_data->order = malloc(sizeof(int) * (total ? total : 1));
+	_data->filter_values = malloc(sizeof(u32) * REPORT_INDEX_MAX_ENTRIES);
+	if (!_data->order || !_data->filter_values) {
+		_e(-1);
+		if (_data->order) free(_data->order);
+		if (_data->filter_values) free(_data->filter_values);
 		free(_data->list);
 		free(_data);
 		sc->d = NULL;
 		return;
 	}
-	_data->cursor = 0;
-	_data->offset = 0;
-	_data->g_staticBuf = C2D_TextBufNew(40 * _data->list->header.cur_size);
-
-	for (int i = 0; i < _data->list->header.cur_size; i++) {
-		ReportListEntry* entry = &_data->list->entries[i];
-		u8 mii_name[MII_UTF8_NAME_LEN];
-		get_mii_name(mii_name, &entry->mii);
-		char render_entry[30 + MII_UTF8_NAME_LEN];
-		snprintf(render_entry, 30 + MII_UTF8_NAME_LEN, "%s  %04lu-%02d-%02d %02d:%02d:%02d", mii_name,
-			entry->received.year, entry->received.month, entry->received.day,
-			entry->received.hour, entry->received.minute, entry->received.second);
-		C2D_TextFontParse(&_data->g_entries[i], getFontIndex(entry->mii.mii_options.char_set), _data->g_staticBuf, render_entry);
+	memset(&_data->filter, 0, sizeof(ReportFilter));
+	_data->num_filter_values = 0;
+	_data->g_headerBuf = C2D_TextBufNew(TEXT_BUF_LEN);
+	_data->g_importBuf = C2D_TextBufNew(STR_REPORT_IMPORT_PROGRESS_LEN + 20);
+	_data->importing = false;
+	for (int i = 0; i < NUM_ROW_SLOTS; i++) {
+		_data->rows[i].buf = C2D_TextBufNew(40);
 	}
+	N(apply_filter)(sc);
+	N(update_import)(sc);
+	N(layout_window)(sc);
+	reportPrefetchStart();
+	N(prefetch)(sc);
 }
 
 void N(render)(Scene* sc) {
@@ -75,22 +304,36 @@ void N(render)(Scene* sc) {
 		return;
 	}
 	u32 clr = C2D_Color32(0, 0, 0, 0xff);
-	for (int i = 0; i < _data->list->header.cur_size; i++) {
-		int ix = _data->list->header.cur_size - i - 1;
-		int x = 35 + i*14 - _data->offset;
-		if (x > -14 && x < 240) {
-			C2D_DrawText(&_data->g_entries[ix], C2D_AlignLeft | C2D_WithColor, 30, x, 0, 0.5, 0.5, clr);
+	int first = N(first_row)(sc);
+	for (int i = first; i < first + VISIBLE_ROWS + 2 && i < _data->num_rows; i++) {
+		N(RowSlot)* slot = &_data->rows[i % NUM_ROW_SLOTS];
+		int x = 35 + i*ROW_HEIGHT - _data->offset;
+		if (slot->row == i && x > -ROW_HEIGHT && x < 240) {
+			C2D_DrawText(&slot->text, C2D_AlignLeft | C2D_WithColor, 30, x, 0, 0.5, 0.5, clr);
 		}
 	}
 	int x = 22;
-	int y = 35 + _data->cursor*14 + 3 - _data->offset;
+	int y = 35 + _data->cursor*ROW_HEIGHT + 3 - _data->offset;
 	C2D_DrawTriangle(x, y, clr, x, y +10, clr, x + 8, y + 5, clr, 0);
+	// rows scroll underneath the header
+	C2D_DrawRectSolid(0, 0, 0, 400, HEADER_HEIGHT, C2D_Color32(0xFF, 0xFF, 0xFF, 0xFF));
+	C2D_DrawText(&_data->g_filter, C2D_AlignLeft | C2D_WithColor, 10, 2, 0, 0.5, 0.5, clr);
+	C2D_DrawText(&_data->g_controls, C2D_AlignLeft | C2D_WithColor, 10, 15, 0, 0.5, 0.5, clr);
+	if (_data->importing) {
+		C2D_DrawText(&_data->g_import, C2D_AlignRight | C2D_WithColor, 390, 2, 0, 0.5, 0.5, clr);
+	}
 }
 
 void N(exit)(Scene* sc) {
 	if (_data) {
-		C2D_TextBufDelete(_data->g_staticBuf);
-		free(_data->g_entries);
+		reportPrefetchStop();
+		for (int i = 0; i < NUM_ROW_SLOTS; i++) {
+			C2D_TextBufDelete(_data->rows[i].buf);
+		}
+		C2D_TextBufDelete(_data->g_headerBuf);
+		C2D_TextBufDelete(_data->g_importBuf);
+		free(_data->order);
+		free(_data->filter_values);
 		free(_data->list);
 		free(_data);
 	}
@@ -100,16 +343,37 @@ SceneResult N(process)(Scene* sc) {
 	hidScanInput();
 	u32 kDown = hidKeysDown();
 	if (!_data) return scene_pop;
-	
+	if (--_data->import_refresh <= 0) N(update_import)(sc);
+
+	if (kDown & KEY_Y) {
+		// step through showing everything, by game and by day. The name search has its own button
+		_data->filter.type = _data->filter.type == REPORT_FILTER_TITLE ? REPORT_FILTER_DAY
+			: _data->filter.type == REPORT_FILTER_DAY ? REPORT_FILTER_NONE : REPORT_FILTER_TITLE;
+		N(load_filter_values)(sc);
+		if (_data->filter.type != REPORT_FILTER_NONE && !_data->num_filter_values) _data->filter.type = REPORT_FILTER_NONE;
+		N(select_filter_value)(sc);
+		N(apply_filter)(sc);
+	}
+	if (kDown & (KEY_L | KEY_R) && _data->num_filter_values && (_data->filter.type == REPORT_FILTER_TITLE || _data->filter.type == REPORT_FILTER_DAY)) {
+		_data->filter_value += ((kDown & KEY_R) && 1) - ((kDown & KEY_L) && 1);
+		if (_data->filter_value < 0) _data->filter_value = _data->num_filter_values - 1;
+		if (_data->filter_value >= _data->num_filter_values) _data->filter_value = 0;
+		N(select_filter_value)(sc);
+		N(apply_filter)(sc);
+	}
+	if (kDown & KEY_X) {
+		N(search_name)(sc);
+	}
 	_data->cursor += ((kDown & KEY_DOWN || kDown & KEY_CPAD_DOWN) && 1) - ((kDown & KEY_UP || kDown & KEY_CPAD_UP) && 1);
 	_data->cursor += ((kDown & KEY_RIGHT || kDown & KEY_CPAD_RIGHT) && 1)*10 - ((kDown & KEY_LEFT || kDown & KEY_CPAD_LEFT) && 1)*10;
-	if (_data->cursor < 0) _data->cursor = (_data->list->header.cur_size-1);
-	if (_data->cursor > (_data->list->header.cur_size-1)) _data->cursor = 0;
-	while(_data->cursor*14 - _data->offset < 2) _data->offset--;
-	while(_data->cursor*14 - _data->offset > 180) _data->offset++;
-	if (kDown & KEY_A) {
-		int selected_i = _data->list->header.cur_size - _data->cursor - 1;
-		ReportListEntry* entry = &_data->list->entries[selected_i];
+	if (_data->cursor < 0) _data->cursor = (_data->num_rows-1);
+	if (_data->cursor > (_data->num_rows-1)) _data->cursor = 0;
+	if (_data->cursor*ROW_HEIGHT - _data->offset < 2) _data->offset = _data->cursor*ROW_HEIGHT - 2;
+	if (_data->cursor*ROW_HEIGHT - _data->offset > 180) _data->offset = _data->cursor*ROW_HEIGHT - 180;
+	N(layout_window)(sc);
+	N(prefetch)(sc);
+	if (kDown & KEY_A && _data->num_rows) {
+		ReportListEntry* entry = N(row_entry)(sc, _data->cursor);
 		sc->next_scene = getReportEntryScene(entry);
 		return scene_push;
 	}
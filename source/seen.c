@@ -0,0 +1,200 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "seen.h"
+#include "debug.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef CECD_HOST
+// the host build has no SD card to pace, see host/Makefile
+#define fread_blk fread
+#define fwrite_blk fwrite
+#define SEEN_DEFAULT_PATH "seen.bin"
+#else
+#include "utils.h"
+#define SEEN_DEFAULT_PATH "sdmc:/config/netpass/seen.bin"
+#endif
+
+#define BITS_OFFSET sizeof(SeenFileHeader)
+#define RING_OFFSET (BITS_OFFSET + SEEN_FILTER_BITS/8)
+
+static char seen_path[100] = SEEN_DEFAULT_PATH;
+static CecdPlatformLock seen_lock;
+static SeenFileHeader header;
+static u8* bits = NULL;
+static SeenKey* ring = NULL;
+// what seenFlush still has to write: the ring slots from dirty_from on, or everything
+static int dirty_from = -1;
+static bool dirty_all = false;
+
+static void make_key(SeenKey* key, SeenKind kind, u32 title_id, CecMessageId message_id) {
+	memset(key, 0, sizeof(SeenKey));
+	key->kind = kind;
+	key->title_id = title_id;
+	memcpy(key->message_id, message_id, sizeof(CecMessageId));
+}
+
+// FNV-1a, the second hash is derived from it for double hashing
+static u64 hash_key(SeenKey* key) {
+	u64 h = 0xcbf29ce484222325;
+	u8* ptr = (u8*)key;
+	for (int i = 0; i < sizeof(SeenKey); i++) {
+		h ^= ptr[i];
+		h *= 0x100000001b3;
+	}
+	return h;
+}
+
+static u32 bit_index(u64 h, int i) {
+	u32 h1 = h;
+	u32 h2 = (h >> 32) | 1;
+	return (h1 + i*h2) % SEEN_FILTER_BITS;
+}
+
+static bool filter_contains(SeenKey* key) {
+	u64 h = hash_key(key);
+	for (int i = 0; i < SEEN_FILTER_HASHES; i++) {
+		u32 b = bit_index(h, i);
+		if (!(bits[b / 8] & (1 << (b % 8)))) return false;
+	}
+	return true;
+}
+
+static void filter_add(SeenKey* key) {
+	u64 h = hash_key(key);
+	for (int i = 0; i < SEEN_FILTER_HASHES; i++) {
+		u32 b = bit_index(h, i);
+		bits[b / 8] |= 1 << (b % 8);
+	}
+}
+
+static bool ring_contains(SeenKey* key) {
+	for (int i = 0; i < header.ring_count; i++) {
+		if (memcmp(&ring[i], key, sizeof(SeenKey)) == 0) return true;
+	}
+	return false;
+}
+
+static void write_all(void) {
+	FILE* f = fopen(seen_path, "wb");
+	if (!f) return;
+	fwrite_blk(&header, sizeof(SeenFileHeader), 1, f);
+	fwrite_blk(bits, SEEN_FILTER_BITS/8, 1, f);
+	fwrite_blk(ring, sizeof(SeenKey), SEEN_RING_SIZE, f);
+	fclose(f);
+}
+
+static void reset(void) {
+	header.magic = 0x4653504E;
+	header.version = 1;
+	header.num_bits = SEEN_FILTER_BITS;
+	header.ring_size = SEEN_RING_SIZE;
+	header.ring_count = 0;
+	header.ring_next = 0;
+	memset(bits, 0, SEEN_FILTER_BITS/8);
+	memset(ring, 0, sizeof(SeenKey) * SEEN_RING_SIZE);
+}
+
+void seenSetPath(const char* path) {
+	snprintf(seen_path, sizeof(seen_path), "%s", path);
+}
+
+void seenInit(void) {
+	cecdPlatformLockInit(&seen_lock);
+	bits = malloc(SEEN_FILTER_BITS/8);
+	ring = malloc(sizeof(SeenKey) * SEEN_RING_SIZE);
+	if (!bits || !ring) {
+		if (bits) free(bits);
+		if (ring) free(ring);
+		bits = NULL;
+		ring = NULL;
+		return;
+	}
+	FILE* f = fopen(seen_path, "rb");
+	if (f) {
+		bool valid = fread_blk(&header, sizeof(SeenFileHeader), 1, f) == 1
+			&& header.magic == 0x4653504E && header.version == 1
+			&& header.num_bits == SEEN_FILTER_BITS && header.ring_size == SEEN_RING_SIZE
+			&& header.ring_count <= SEEN_RING_SIZE && header.ring_next < SEEN_RING_SIZE
+			&& fread_blk(bits, SEEN_FILTER_BITS/8, 1, f) == 1
+			&& fread_blk(ring, sizeof(SeenKey), SEEN_RING_SIZE, f) == SEEN_RING_SIZE;
+		fclose(f);
+		if (valid) return;
+	}
+	reset();
+	write_all();
+}
+
+bool seenContains(SeenKind kind, u32 title_id, CecMessageId message_id) {
+	if (!bits) return false;
+	SeenKey key;
+	make_key(&key, kind, title_id, message_id);
+	cecdPlatformLock(&seen_lock);
+	// the filter has no false negatives, so most new messages are answered right here
+	bool found = filter_contains(&key) && ring_contains(&key);
+	cecdPlatformUnlock(&seen_lock);
+	return found;
+}
+
+void seenAdd(SeenKind kind, u32 title_id, CecMessageId message_id) {
+	if (!bits) return;
+	SeenKey key;
+	make_key(&key, kind, title_id, message_id);
+	cecdPlatformLock(&seen_lock);
+	if (filter_contains(&key) && ring_contains(&key)) goto cleanup;
+	u32 slot = header.ring_next;
+	memcpy(&ring[slot], &key, sizeof(SeenKey));
+	header.ring_next = (header.ring_next + 1) % SEEN_RING_SIZE;
+	if (header.ring_count < SEEN_RING_SIZE) header.ring_count++;
+	if (header.ring_next == 0) {
+		// the ring wrapped, rebuild the filter from what is left in it so that
+		// evicted keys stop producing positive hits
+		memset(bits, 0, SEEN_FILTER_BITS/8);
+		for (int i = 0; i < header.ring_count; i++) filter_add(&ring[i]);
+		dirty_all = true;
+		goto cleanup;
+	}
+	filter_add(&key);
+	if (dirty_from < 0) dirty_from = slot;
+cleanup:
+	cecdPlatformUnlock(&seen_lock);
+}
+
+void seenFlush(void) {
+	if (!bits) return;
+	cecdPlatformLock(&seen_lock);
+	if (!dirty_all && dirty_from < 0) goto cleanup;
+	FILE* f = dirty_all ? NULL : fopen(seen_path, "r+b");
+	if (!f) {
+		write_all();
+		goto done;
+	}
+	// without a wrap in between, the new keys are the ring slots up to ring_next
+	fwrite_blk(&header, sizeof(SeenFileHeader), 1, f);
+	fwrite_blk(bits, SEEN_FILTER_BITS/8, 1, f);
+	fseek(f, RING_OFFSET + dirty_from * sizeof(SeenKey), SEEK_SET);
+	fwrite_blk(&ring[dirty_from], sizeof(SeenKey), header.ring_next - dirty_from, f);
+	fclose(f);
+done:
+	dirty_from = -1;
+	dirty_all = false;
+cleanup:
+	cecdPlatformUnlock(&seen_lock);
+}
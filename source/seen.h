@@ -0,0 +1,56 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cecd.h"
+
+// bloom filter in front of a ring of the most recent keys, which is what positive hits are checked against
+#define SEEN_FILTER_BITS (32*1024)
+#define SEEN_FILTER_HASHES 4
+#define SEEN_RING_SIZE 4096
+
+// a message written to the log isn't necessarily in the inbox and vice versa, so they are tracked apart
+typedef enum {
+	SEEN_LOG = 0,
+	SEEN_INBOX,
+} SeenKind;
+
+typedef struct {
+	u32 kind;
+	u32 title_id;
+	CecMessageId message_id;
+} SeenKey;
+
+typedef struct {
+	u32 magic; // 0x4653504E "NPSF"
+	int version; // 1
+	u32 num_bits;
+	u32 ring_size;
+	u32 ring_count;
+	u32 ring_next;
+} SeenFileHeader;
+
+// must be called before seenInit to have an effect
+void seenSetPath(const char* path);
+void seenInit(void);
+// true if the message was definitely seen before
+bool seenContains(SeenKind kind, u32 title_id, CecMessageId message_id);
+// only in memory, seenFlush writes what was added since the last flush in one go
+void seenAdd(SeenKind kind, u32 title_id, CecMessageId message_id);
+void seenFlush(void);
@@ -0,0 +1,151 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tasks.h"
+#include "api.h"
+#include "debug.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+void taskGraphInit(TaskGraph* g) {
+	memset(g, 0, sizeof(TaskGraph));
+	LightLock_Init(&g->lock);
+	CondVar_Init(&g->cond);
+}
+
+Task* taskGraphAdd(TaskGraph* g, const char* name, TaskFunc func, int num_deps, ...) {
+	if (g->num_tasks >= TASK_GRAPH_MAX_TASKS || num_deps > TASK_MAX_DEPS) return NULL;
+	Task* t = &g->tasks[g->num_tasks++];
+	memset(t, 0, sizeof(Task));
+	t->name = name;
+	t->func = func;
+	va_list args;
+	va_start(args, num_deps);
+	for (int i = 0; i < num_deps; i++) {
+		Task* dep = va_arg(args, Task*);
+		if (dep) t->deps[t->num_deps++] = dep;
+	}
+	va_end(args);
+	return t;
+}
+
+static bool task_finished(Task* t) {
+	return t->state == TASK_STATE_DONE || t->state == TASK_STATE_FAILED || t->state == TASK_STATE_SKIPPED;
+}
+
+// must hold the lock. Returns a runnable task, marking tasks with failed deps as skipped along the way
+static Task* pick_task(TaskGraph* g) {
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int i = 0; i < g->num_tasks; i++) {
+			Task* t = &g->tasks[i];
+			if (t->state != TASK_STATE_PENDING) continue;
+			bool ready = true;
+			bool skip = false;
+			for (int j = 0; j < t->num_deps; j++) {
+				Task* dep = t->deps[j];
+				if (dep->state == TASK_STATE_FAILED || dep->state == TASK_STATE_SKIPPED) {
+					skip = true;
+					break;
+				}
+				if (dep->state != TASK_STATE_DONE) ready = false;
+			}
+			if (skip) {
+				DEBUG_PRINTF("Skipping task %s\n", t->name);
+				t->state = TASK_STATE_SKIPPED;
+				g->num_finished++;
+				// tasks earlier in the list may depend on this one
+				changed = true;
+				continue;
+			}
+			if (!ready) continue;
+			t->state = TASK_STATE_RUNNING;
+			return t;
+		}
+	}
+	return NULL;
+}
+
+static void task_worker(void* p) {
+	TaskGraph* g = (TaskGraph*)p;
+	LightLock_Lock(&g->lock);
+	while (g->num_finished < g->num_tasks) {
+		Task* t = pick_task(g);
+		if (!t) {
+			if (g->num_finished >= g->num_tasks) break;
+			CondVar_Wait(&g->cond, &g->lock);
+			continue;
+		}
+		for (int i = 0; i < t->num_deps; i++) {
+			if (!t->critical_dep || t->deps[i]->end > t->critical_dep->end) t->critical_dep = t->deps[i];
+		}
+		t->start = svcGetSystemTick() - g->start;
+		LightLock_Unlock(&g->lock);
+
+		bool success = t->func();
+
+		LightLock_Lock(&g->lock);
+		t->end = svcGetSystemTick() - g->start;
+		t->state = success ? TASK_STATE_DONE : TASK_STATE_FAILED;
+		g->num_finished++;
+		DEBUG_PRINTF("Task %s %s after %llu ms\n", t->name, success ? "done" : "failed", (t->end - t->start) / CPU_TICKS_PER_MSEC);
+		CondVar_Broadcast(&g->cond);
+	}
+	// wake up anybody still waiting so that they notice we are done
+	CondVar_Broadcast(&g->cond);
+	LightLock_Unlock(&g->lock);
+}
+
+void taskGraphRun(TaskGraph* g, int num_workers) {
+	if (num_workers < 1) num_workers = 1;
+	if (num_workers > TASK_GRAPH_MAX_WORKERS) num_workers = TASK_GRAPH_MAX_WORKERS;
+	g->start = svcGetSystemTick();
+	Thread threads[TASK_GRAPH_MAX_WORKERS] = {0};
+	// the calling thread is a worker too, so we only spawn the rest
+	for (int i = 1; i < num_workers; i++) {
+		threads[i] = threadCreate(task_worker, g, 8*1024, main_thread_prio()-1, -2, false);
+	}
+	task_worker(g);
+	for (int i = 1; i < num_workers; i++) {
+		if (!threads[i]) continue;
+		threadJoin(threads[i], U64_MAX);
+		threadFree(threads[i]);
+	}
+}
+
+void taskGraphPrintCriticalPath(TaskGraph* g) {
+	Task* last = NULL;
+	for (int i = 0; i < g->num_tasks; i++) {
+		Task* t = &g->tasks[i];
+		if (t->state != TASK_STATE_DONE && t->state != TASK_STATE_FAILED) continue;
+		if (!last || t->end > last->end) last = t;
+	}
+	if (!last) return;
+	// walk back from the task that finished last
+	Task* path[TASK_GRAPH_MAX_TASKS];
+	int len = 0;
+	for (Task* t = last; t && len < TASK_GRAPH_MAX_TASKS; t = t->critical_dep) {
+		path[len++] = t;
+	}
+	printf("Startup took %llu ms:", last->end / CPU_TICKS_PER_MSEC);
+	for (int i = len - 1; i >= 0; i--) {
+		printf(" %s%s", path[i]->name, i ? " >" : "\n");
+	}
+}
@@ -0,0 +1,65 @@
+/**
+ * NetPass
+ * Copyright (C) 2026 Sorunome
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <3ds.h>
+
+#define TASK_GRAPH_MAX_TASKS 16
+#define TASK_MAX_DEPS 4
+#define TASK_GRAPH_MAX_WORKERS 4
+
+typedef enum {
+	TASK_STATE_PENDING = 0,
+	TASK_STATE_RUNNING,
+	TASK_STATE_DONE,
+	TASK_STATE_FAILED,
+	TASK_STATE_SKIPPED, // a dependency failed, so this never ran
+} TaskState;
+
+// a task returns false to mark itself failed, which skips everything depending on it
+typedef bool (*TaskFunc)(void);
+
+typedef struct Task Task;
+struct Task {
+	const char* name;
+	TaskFunc func;
+	Task* deps[TASK_MAX_DEPS];
+	int num_deps;
+	TaskState state;
+	u64 start; // ticks, relative to the graph start
+	u64 end;
+	Task* critical_dep; // the dependency that finished last, i.e. the one we waited for
+};
+
+typedef struct {
+	Task tasks[TASK_GRAPH_MAX_TASKS];
+	int num_tasks;
+	int num_finished;
+	LightLock lock;
+	CondVar cond;
+	u64 start;
+} TaskGraph;
+
+void taskGraphInit(TaskGraph* g);
+// add a task, followed by num_deps Task* it depends on. Returns NULL if the graph is full
+Task* taskGraphAdd(TaskGraph* g, const char* name, TaskFunc func, int num_deps, ...);
+// run all tasks on num_workers threads and block until they are all finished or skipped
+void taskGraphRun(TaskGraph* g, int num_workers);
+// print the chain of tasks that determined the total runtime
+void taskGraphPrintCriticalPath(TaskGraph* g);
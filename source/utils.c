@@ -17,6 +17,7 @@
  */
 
 #include "utils.h"
+#include "cec_message.h"
 #include <string.h>
 #include <sys/stat.h>
 #include <ctype.h>
@@ -27,30 +28,17 @@
 
 // cppcheck-suppress unusedFunction
 void* cecGetExtHeader(CecMessageHeader* msg, u32 type) {
-	u32 counter = sizeof(CecMessageHeader);
-	while (counter < msg->total_header_size) {
-		u32 this_type = ((u32*)(((u8*)msg) + counter))[0];
-		u32 this_size = ((u32*)(((u8*)msg) + counter))[1];
-		if (this_type == type) return ((u8*)msg) + counter;
-		counter += this_size;
-		// we might have to do extra aligning
-		if (counter %4) counter += 4 - counter % 4;
-	}
-	return NULL;
+	CecMessageView v;
+	if (!cecMessageViewInit(&v, (u8*)msg, msg->message_size)) return NULL;
+	return cecMessageExtHeader(&v, type, NULL);
 }
 
 // cppcheck-suppress unusedFunction
 u32 cecGetExtHeaderSize(CecMessageHeader* msg, u32 type) {
-	u32 counter = sizeof(CecMessageHeader);
-	while (counter < msg->total_header_size) {
-		u32 this_type = ((u32*)(((u8*)msg) + counter))[0];
-		u32 this_size = ((u32*)(((u8*)msg) + counter))[1];
-		if (this_type == type) return this_size;
-		counter += this_size;
-		// we might have to do extra aligning
-		if (counter %4) counter += 4 - counter % 4;
-	}
-	return 0;
+	CecMessageView v;
+	u32 size = 0;
+	if (cecMessageViewInit(&v, (u8*)msg, msg->message_size)) cecMessageExtHeader(&v, type, &size);
+	return size;
 }
 
 // from https://nachtimwald.com/2017/11/18/base64-encode-and-decode-in-c/
@@ -250,17 +238,6 @@ error:
 	return res;
 }
 
-u8* memsearch(u8* buf, size_t buf_len, u8* cmp, size_t cmp_len) {
-	u8* buf_orig = buf;
-	while (buf_len - ((int)(buf - buf_orig)) > 0 && (buf = memchr(buf, *(uint8_t*)cmp, buf_len - ((int)(buf - buf_orig))))) {
-		if (memcmp(buf, cmp, cmp_len) == 0) {
-			return buf;
-		}
-		buf++;
-	}
-	return NULL;
-}
-
 // from https://github.com/joel16/3DShell/blob/b0c6c9e6a779957b5fb9caf4d6d9cfe3acb4ff92/source/textures.cpp#L150
 u32 GetNextPowerOf2(u32 v) {
 	v--;
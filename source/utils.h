@@ -39,6 +39,7 @@
 #define MAX7(a, b, c, d, e, f, g) MAX2(a, MAX6(b, c, d, e, f, g))
 #define MAX8(a, b, c, d, e, f, g, h) MAX2(a, MAX7(b, c, d, e, f, g, h))
 
+// these validate the message on every call, use a CecMessageView to look up more than one thing
 void* cecGetExtHeader(CecMessageHeader* msg, u32 type);
 u32 cecGetExtHeaderSize(CecMessageHeader* msg, u32 type);
 char* b64encode(u8* in, size_t len);
@@ -48,7 +49,6 @@ Result APT_Wrap(u32 in_size, void* in, u32 nonce_offset, u32 nonce_size, u32 out
 Result APT_Unwrap(u32 in_size, void* in, u32 nonce_offset, u32 nonce_size, u32 out_size, void* out);
 u16 crc16_ccitt(void const *buf, size_t len, uint32_t starting_val);
 Result decryptMii(void* data, MiiData* mii);
-u8* memsearch(u8* buf, size_t buf_len, u8* cmp, size_t cmp_len);
 void C2D_ImageDelete(C2D_Image* img);
 bool loadJpeg(C2D_Image* img, u8* data, u32 size);
 size_t fread_blk(void* buffer, size_t size, size_t count, FILE* stream);